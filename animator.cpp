@@ -21,7 +21,7 @@
 
 #include "animator.h"
 
-#include <QMovie>
+#include "framestore.h"
 
 Animator* Animator::m_self = 0;
 
@@ -40,22 +40,29 @@ Animator::~Animator()
 {
 }
 
-void Animator::connectPreEditBarMovie(QMovie* movie)
+void Animator::connectPreEditBarMovie(FrameStore* movie)
 {
-    connect(movie, SIGNAL(frameChanged(int)), this, SIGNAL(animatePreEditBar()));
+    connect(movie, SIGNAL(frameChanged(int)), this, SLOT(slotPreEditBarFrameChanged()));
+    connect(movie, SIGNAL(destroyed(QObject*)), this, SLOT(slotMovieDestroyed(QObject*)));
     connect(this, SIGNAL(enabled()), movie, SLOT(start()));
     connect(this, SIGNAL(disabled()), movie, SLOT(stop()));
     movie->start();
 }
 
-void Animator::connectStatusBarMovie(QMovie* movie)
+void Animator::connectStatusBarMovie(FrameStore* movie)
 {
-    connect(movie, SIGNAL(frameChanged(int)), this, SIGNAL(animateStatusBar()));
+    connect(movie, SIGNAL(frameChanged(int)), this, SLOT(slotStatusBarFrameChanged()));
+    connect(movie, SIGNAL(destroyed(QObject*)), this, SLOT(slotMovieDestroyed(QObject*)));
     connect(this, SIGNAL(enabled()), movie, SLOT(start()));
     connect(this, SIGNAL(disabled()), movie, SLOT(stop()));
     movie->start();
 }
 
+void Animator::setMovieRect(const FrameStore* movie, const QRect& rect)
+{
+    m_movieRects[ movie ] = rect;
+}
+
 void Animator::enable()
 {
     emit enabled();
@@ -65,3 +72,26 @@ void Animator::disable()
 {
     emit disabled();
 }
+
+void Animator::slotPreEditBarFrameChanged()
+{
+    QHash<const QObject*, QRect>::ConstIterator it = m_movieRects.constFind(sender());
+    if (it == m_movieRects.constEnd())
+        emit animatePreEditBar(QRect());
+    else if (!it.value().isEmpty())
+        emit animatePreEditBar(it.value());
+}
+
+void Animator::slotStatusBarFrameChanged()
+{
+    QHash<const QObject*, QRect>::ConstIterator it = m_movieRects.constFind(sender());
+    if (it == m_movieRects.constEnd())
+        emit animateStatusBar(QRect());
+    else if (!it.value().isEmpty())
+        emit animateStatusBar(it.value());
+}
+
+void Animator::slotMovieDestroyed(QObject* movie)
+{
+    m_movieRects.remove(movie);
+}
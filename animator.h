@@ -22,9 +22,11 @@
 #ifndef ANIMATOR_H
 #define ANIMATOR_H
 
+#include <QHash>
 #include <QObject>
+#include <QRect>
 
-class QMovie;
+class FrameStore;
 
 class Animator : public QObject
 {
@@ -32,17 +34,25 @@ class Animator : public QObject
 public:
     static Animator* self();
     virtual ~Animator();
-    void connectPreEditBarMovie(QMovie* movie);
-    void connectStatusBarMovie(QMovie* movie);
+    void connectPreEditBarMovie(FrameStore* movie);
+    void connectStatusBarMovie(FrameStore* movie);
+    /// area repainted on frame changes of movie, empty for none
+    /// movies without any area repaint the whole widget
+    void setMovieRect(const FrameStore* movie, const QRect& rect);
     void enable();
     void disable();
 Q_SIGNALS:
-    void animatePreEditBar();
-    void animateStatusBar();
+    void animatePreEditBar(const QRect& rect);
+    void animateStatusBar(const QRect& rect);
     void enabled();
     void disabled();
+private Q_SLOTS:
+    void slotPreEditBarFrameChanged();
+    void slotStatusBarFrameChanged();
+    void slotMovieDestroyed(QObject* movie);
 private:
     explicit Animator();
+    QHash<const QObject*, QRect> m_movieRects;
     static Animator* m_self;
 };
 
@@ -0,0 +1,211 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "compiledskin.h"
+
+#include <QAtomicInt>
+#include <QBuffer>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+
+#include <string.h>
+
+/// keeps the file mapped while the skin or any image of it is alive
+class CompiledSkinMapping
+{
+public:
+    QFile file;
+    uchar* data;
+    qint64 size;
+    QAtomicInt ref;
+};
+
+static void releaseMapping(void* info)
+{
+    CompiledSkinMapping* mapping = static_cast<CompiledSkinMapping*>(info);
+    if (!mapping->ref.deref())
+        delete mapping;
+}
+
+static bool readHeader(QDataStream& ds, quint32& sourceType, quint32& entryCount,
+                       quint32& atlasWidth, quint32& atlasHeight, quint64& atlasOffset)
+{
+    ds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[8];
+    if (ds.readRawData(magic, 8) != 8 || memcmp(magic, COMPILEDSKIN_MAGIC, 8) != 0)
+        return false;
+
+    quint32 version;
+    ds >> version >> sourceType >> entryCount >> atlasWidth >> atlasHeight >> atlasOffset;
+    if (ds.status() != QDataStream::Ok || version != COMPILEDSKIN_VERSION) {
+        qWarning() << "unsupported compiled skin version";
+        return false;
+    }
+
+    return sourceType == CompiledSkin::SogouSource || sourceType == CompiledSkin::FcitxSource;
+}
+
+CompiledSkin::CompiledSkin()
+{
+    m_mapping = 0;
+    m_sourceType = InvalidSource;
+    m_atlasWidth = 0;
+    m_atlas = 0;
+}
+
+CompiledSkin::~CompiledSkin()
+{
+    if (m_mapping)
+        releaseMapping(m_mapping);
+}
+
+bool CompiledSkin::open(const QString& file)
+{
+    CompiledSkinMapping* mapping = new CompiledSkinMapping;
+    mapping->ref.store(1);
+    mapping->file.setFileName(file);
+    mapping->size = mapping->file.size();
+    mapping->data = mapping->file.open(QIODevice::ReadOnly) ? mapping->file.map(0, mapping->size) : 0;
+    if (!mapping->data) {
+        delete mapping;
+        return false;
+    }
+
+    QBuffer buffer;
+    buffer.setData(QByteArray::fromRawData((const char*)mapping->data, mapping->size));
+    buffer.open(QIODevice::ReadOnly);
+    QDataStream ds(&buffer);
+
+    quint32 sourceType, entryCount, atlasWidth, atlasHeight;
+    quint64 atlasOffset;
+    if (!readHeader(ds, sourceType, entryCount, atlasWidth, atlasHeight, atlasOffset)
+        || atlasOffset + (quint64)atlasWidth * atlasHeight * 4 > (quint64)mapping->size) {
+        delete mapping;
+        return false;
+    }
+
+    QHash<QString, Entry> entries;
+    for (quint32 i = 0; i < entryCount; ++i) {
+        QByteArray name;
+        Entry entry;
+        ds >> name >> entry.kind;
+        if (entry.kind == DataEntry) {
+            ds >> entry.offset >> entry.size;
+            if ((quint64)entry.offset + entry.size > (quint64)mapping->size)
+                break;
+        }
+        else {
+            entry.offset = 0;
+            entry.size = 0;
+            quint32 frameCount;
+            ds >> frameCount >> entry.loopCount;
+            if (frameCount == 0 || frameCount > 1024)
+                break;
+            entry.frames.resize(frameCount);
+            for (quint32 j = 0; j < frameCount; ++j) {
+                Frame& f = entry.frames[j];
+                ds >> f.x >> f.y >> f.width >> f.height >> f.delay;
+                if (f.width == 0 || f.height == 0
+                    || (quint64)f.x + f.width > atlasWidth || (quint64)f.y + f.height > atlasHeight)
+                    ds.setStatus(QDataStream::ReadCorruptData);
+            }
+        }
+        if (ds.status() != QDataStream::Ok)
+            break;
+        entries.insert(QString::fromUtf8(name), entry);
+    }
+
+    if (ds.status() != QDataStream::Ok || (quint32)entries.count() != entryCount) {
+        qWarning() << "corrupt compiled skin" << file;
+        delete mapping;
+        return false;
+    }
+
+    if (m_mapping)
+        releaseMapping(m_mapping);
+    m_mapping = mapping;
+    m_sourceType = (SourceType)sourceType;
+    m_atlasWidth = atlasWidth;
+    m_atlas = mapping->data + atlasOffset;
+    m_entries = entries;
+    return true;
+}
+
+CompiledSkin::SourceType CompiledSkin::sourceType(const QString& file)
+{
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly))
+        return InvalidSource;
+
+    QDataStream ds(&f);
+    quint32 sourceType, entryCount, atlasWidth, atlasHeight;
+    quint64 atlasOffset;
+    if (!readHeader(ds, sourceType, entryCount, atlasWidth, atlasHeight, atlasOffset))
+        return InvalidSource;
+
+    return (SourceType)sourceType;
+}
+
+CompiledSkin::SourceType CompiledSkin::sourceType() const
+{
+    return m_sourceType;
+}
+
+QStringList CompiledSkin::entries() const
+{
+    return m_entries.keys();
+}
+
+bool CompiledSkin::contains(const QString& name) const
+{
+    return m_entries.contains(name);
+}
+
+QByteArray CompiledSkin::data(const QString& name) const
+{
+    QHash<QString, Entry>::ConstIterator it = m_entries.constFind(name);
+    if (it == m_entries.constEnd() || it->kind != DataEntry)
+        return QByteArray();
+    return QByteArray((const char*)m_mapping->data + it->offset, it->size);
+}
+
+QVector<QImage> CompiledSkin::frames(const QString& name, QVector<int>* delays, int* loopCount) const
+{
+    QVector<QImage> images;
+    QHash<QString, Entry>::ConstIterator it = m_entries.constFind(name);
+    if (it == m_entries.constEnd() || it->kind != ImageEntry)
+        return images;
+
+    if (loopCount)
+        *loopCount = it->loopCount;
+    const int bytesPerLine = m_atlasWidth * 4;
+    foreach (const Frame& f, it->frames) {
+        /// every image holds a reference on the mapping
+        m_mapping->ref.ref();
+        images.append(QImage(m_atlas + f.y * bytesPerLine + f.x * 4, f.width, f.height, bytesPerLine,
+                             QImage::Format_ARGB32_Premultiplied, releaseMapping, m_mapping));
+        if (delays)
+            delays->append(f.delay);
+    }
+    return images;
+}
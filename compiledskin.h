@@ -0,0 +1,94 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPILEDSKIN_H
+#define COMPILEDSKIN_H
+
+#include <QHash>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * Compiled skin file (.kskin), written by kimtoy-skinc
+ *
+ * All values are little endian.
+ *
+ *   header   magic "KIMTOYSK", version, source type, entry count,
+ *            atlas width, atlas height, atlas offset (64 bit)
+ *   index    per entry: utf-8 name, kind, then
+ *            data   offset and size of the raw bytes
+ *            image  frame count, loop count, per frame x, y, width, height, delay
+ *   blobs    raw entries such as skin.ini or fcitx_skin.conf
+ *   atlas    premultiplied ARGB32 pixels of all image frames, page aligned
+ *
+ * The file is mapped as a whole and images point straight into the atlas.
+ */
+
+#define COMPILEDSKIN_MAGIC "KIMTOYSK"
+#define COMPILEDSKIN_VERSION 2
+#define COMPILEDSKIN_SUFFIX ".kskin"
+
+class CompiledSkinMapping;
+
+class CompiledSkin
+{
+public:
+    /// format of the skin the file was compiled from
+    enum SourceType { InvalidSource = 0, SogouSource = 1, FcitxSource = 2 };
+    enum EntryKind { DataEntry = 0, ImageEntry = 1 };
+
+    explicit CompiledSkin();
+    ~CompiledSkin();
+
+    /// map file and read its index
+    bool open(const QString& file);
+    /// source type recorded in the header of file, without mapping it
+    static SourceType sourceType(const QString& file);
+
+    SourceType sourceType() const;
+    QStringList entries() const;
+    bool contains(const QString& name) const;
+    QByteArray data(const QString& name) const;
+    /// frames of an image entry, sharing the mapped atlas memory
+    QVector<QImage> frames(const QString& name, QVector<int>* delays = 0, int* loopCount = 0) const;
+private:
+    struct Frame {
+        quint32 x, y, width, height;
+        qint32 delay;
+    };
+    struct Entry {
+        quint8 kind;
+        quint32 offset;
+        quint32 size;
+        qint32 loopCount;
+        QVector<Frame> frames;
+    };
+    Q_DISABLE_COPY(CompiledSkin)
+    CompiledSkinMapping* m_mapping;
+    SourceType m_sourceType;
+    quint32 m_atlasWidth;
+    const uchar* m_atlas;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // COMPILEDSKIN_H
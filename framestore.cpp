@@ -0,0 +1,262 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framestore.h"
+
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QMovie>
+
+#include "kimgio-apng/apng.h"
+
+/// upper bound of frames decoded from one asset
+static const int MAX_FRAMES = 1024;
+
+/// delay used for frames without any
+static const int DEFAULT_DELAY = 100;
+
+qint64 FrameStore::s_budget = 32 * 1024 * 1024;
+qint64 FrameStore::s_used = 0;
+
+FrameStore::FrameStore(QObject* parent)
+        : QObject(parent)
+{
+    m_currentFrame = 0;
+    m_loopCount = -1;
+    m_loopsDone = 0;
+    m_cost = 0;
+    m_buffer = 0;
+    m_movie = 0;
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(slotNextFrame()));
+}
+
+FrameStore::~FrameStore()
+{
+    clear();
+}
+
+void FrameStore::setBudget(qint64 bytes)
+{
+    s_budget = bytes;
+}
+
+void FrameStore::clear()
+{
+    m_timer.stop();
+    s_used -= m_cost;
+    m_cost = 0;
+    m_frames.clear();
+    m_images.clear();
+    m_delays.clear();
+    m_unionMask = SpanMask();
+    m_currentFrame = 0;
+    m_loopCount = -1;
+    m_loopsDone = 0;
+    delete m_movie;
+    m_movie = 0;
+    delete m_buffer;
+    m_buffer = 0;
+}
+
+void FrameStore::setData(const QByteArray& data, const QByteArray& format)
+{
+    clear();
+
+    QBuffer buffer;
+    buffer.setData(data);
+    /// a single pass, the apng handler has nothing to loop over
+    buffer.setProperty(APNG_FRAME_CACHE_PROPERTY, false);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, format);
+
+    bool fits = true;
+    qint64 cost = 0;
+    int count = 0;
+    while (count < MAX_FRAMES && reader.canRead()) {
+        QImage image = reader.read();
+        if (image.isNull())
+            break;
+
+        ++count;
+        uniteFrameMask(image);
+
+        if (fits) {
+            cost += image.width() * image.height() * 4;
+            if (s_used + cost > s_budget) {
+                /// keep decoding for the union mask only
+                fits = false;
+                m_frames.clear();
+                m_delays.clear();
+            }
+            else {
+                m_frames.append(QPixmap::fromImage(image.convertToFormat(QImage::Format_ARGB32_Premultiplied)));
+                int delay = reader.nextImageDelay();
+                m_delays.append(delay > 0 ? delay : DEFAULT_DELAY);
+            }
+        }
+
+        /// the apng reader rewinds by itself after the last frame
+        if (reader.imageCount() > 0 && count >= reader.imageCount())
+            break;
+    }
+
+    if (fits && !m_frames.isEmpty()) {
+        m_loopCount = reader.loopCount();
+        m_cost = cost;
+        s_used += m_cost;
+        return;
+    }
+
+    /// over budget, decode while playing
+    m_frames.clear();
+    m_delays.clear();
+    m_buffer = new QBuffer;
+    /// streaming exists to stay within the budget, the apng handler must not cache behind it
+    m_buffer->setProperty(APNG_FRAME_CACHE_PROPERTY, false);
+    m_buffer->setData(data);
+    m_movie = new QMovie(m_buffer, format);
+    connect(m_movie, SIGNAL(frameChanged(int)), this, SIGNAL(frameChanged(int)));
+}
+
+void FrameStore::setFrames(const QVector<QImage>& frames, const QVector<int>& delays, int loopCount)
+{
+    clear();
+
+    m_loopCount = loopCount;
+    qint64 cost = 0;
+    int count = qMin(frames.count(), MAX_FRAMES);
+    for (int i = 0; i < count; ++i) {
+        const QImage& image = frames.at(i);
+        uniteFrameMask(image);
+        cost += image.width() * image.height() * 4;
+        int delay = delays.value(i);
+        m_delays.append(delay > 0 ? delay : DEFAULT_DELAY);
+    }
+
+    if (s_used + cost > s_budget) {
+        /// over budget, keep the images and convert while playing
+        m_images = frames.mid(0, count);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+        m_frames.append(QPixmap::fromImage(frames.at(i)));
+    m_cost = cost;
+    s_used += m_cost;
+}
+
+void FrameStore::uniteFrameMask(const QImage& image)
+{
+    SpanMask frameMask = SpanMask::fromImage(image);
+    if (frameMask.width() <= m_unionMask.width() && frameMask.height() <= m_unionMask.height()) {
+        m_unionMask.unite(frameMask, 0, 0);
+        return;
+    }
+
+    SpanMask mask(qMax(frameMask.width(), m_unionMask.width()), qMax(frameMask.height(), m_unionMask.height()));
+    mask.unite(m_unionMask, 0, 0);
+    mask.unite(frameMask, 0, 0);
+    m_unionMask = mask;
+}
+
+QPixmap FrameStore::currentPixmap() const
+{
+    if (m_movie)
+        return m_movie->currentPixmap();
+    if (!m_images.isEmpty())
+        return QPixmap::fromImage(m_images.at(m_currentFrame));
+    if (m_frames.isEmpty())
+        return QPixmap();
+    return m_frames.at(m_currentFrame);
+}
+
+int FrameStore::currentFrameNumber() const
+{
+    if (m_movie)
+        return m_movie->currentFrameNumber();
+    return m_currentFrame;
+}
+
+int FrameStore::frameCount() const
+{
+    return m_delays.count();
+}
+
+QPixmap FrameStore::framePixmap(int frameNumber) const
+{
+    if (!m_images.isEmpty())
+        return QPixmap::fromImage(m_images.value(frameNumber));
+    return m_frames.value(frameNumber);
+}
+
+bool FrameStore::isStreaming() const
+{
+    return m_movie != 0;
+}
+
+void FrameStore::start()
+{
+    if (m_movie) {
+        m_movie->start();
+        return;
+    }
+
+    if (isFinished()) {
+        /// replay from the start like QMovie does
+        m_currentFrame = 0;
+        m_loopsDone = 0;
+    }
+
+    emit frameChanged(m_currentFrame);
+    if (m_delays.count() > 1)
+        m_timer.start(m_delays.at(m_currentFrame));
+}
+
+void FrameStore::stop()
+{
+    if (m_movie) {
+        m_movie->stop();
+        return;
+    }
+
+    m_timer.stop();
+}
+
+bool FrameStore::isFinished() const
+{
+    return m_loopCount >= 0 && m_loopsDone >= m_loopCount && m_currentFrame == m_delays.count() - 1;
+}
+
+void FrameStore::slotNextFrame()
+{
+    if (isFinished()) {
+        /// loops used up, stay on the last frame
+        return;
+    }
+
+    m_currentFrame = (m_currentFrame + 1) % m_delays.count();
+    if (m_currentFrame == 0)
+        ++m_loopsDone;
+    emit frameChanged(m_currentFrame);
+    m_timer.start(m_delays.at(m_currentFrame));
+}
@@ -0,0 +1,96 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMESTORE_H
+#define FRAMESTORE_H
+
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QTimer>
+#include <QVector>
+
+#include "spanmask.h"
+
+class QBuffer;
+class QMovie;
+
+/**
+ * Animated theme asset.
+ *
+ * All frames are decoded once into premultiplied pixmaps together with
+ * their delays, as long as they fit into the shared memory budget.
+ * Assets above the budget fall back to streaming decode through QMovie.
+ * The union mask of all frames is computed at load time in both cases.
+ */
+class FrameStore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameStore(QObject* parent = 0);
+    virtual ~FrameStore();
+    void setData(const QByteArray& data, const QByteArray& format);
+    /// premultiplied frames decoded elsewhere, above the budget they are uploaded while playing
+    void setFrames(const QVector<QImage>& frames, const QVector<int>& delays, int loopCount = -1);
+    QPixmap currentPixmap() const;
+    int currentFrameNumber() const;
+    /// number of frames, 0 when streaming through QMovie
+    int frameCount() const;
+    QPixmap framePixmap(int frameNumber) const;
+    bool isStreaming() const;
+    /// opaque area covered by any frame, fixed for the whole animation
+    const SpanMask& unionMask() const {
+        return m_unionMask;
+    }
+    /// size of the union of all frames
+    QSize frameSize() const {
+        return QSize(m_unionMask.width(), m_unionMask.height());
+    }
+    /// memory budget in bytes shared by all frame stores
+    static void setBudget(qint64 bytes);
+public Q_SLOTS:
+    void start();
+    void stop();
+Q_SIGNALS:
+    void frameChanged(int frameNumber);
+private Q_SLOTS:
+    void slotNextFrame();
+private:
+    void clear();
+    void uniteFrameMask(const QImage& image);
+    bool isFinished() const;
+    QVector<QPixmap> m_frames;
+    QVector<QImage> m_images;
+    QVector<int> m_delays;
+    SpanMask m_unionMask;
+    int m_currentFrame;
+    /// repeats after the first pass as QImageReader reports them, -1 loops forever
+    int m_loopCount;
+    int m_loopsDone;
+    qint64 m_cost;
+    QTimer m_timer;
+    QBuffer* m_buffer;
+    QMovie* m_movie;
+    static qint64 s_budget;
+    static qint64 s_used;
+};
+
+#endif // FRAMESTORE_H
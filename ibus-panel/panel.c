@@ -19,15 +19,21 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h> // for setlocale
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <ibus.h>
 #if !IBUS_CHECK_VERSION(1,3,99)
 #include <gio/gio.h>
 #include <ibuspanelservice.h>
 #endif
 #include "panel.h"
+#include "../impanelproto.h"
 
 #if !IBUS_CHECK_VERSION(1,3,99)
 #ifndef DBUS_ERROR_FAILED
@@ -44,6 +50,17 @@ struct _IBusPanelImpanel {
     IBusInputContext   *input_context;
     IBusProperty       *logo_prop;
     IBusProperty       *about_prop;
+    gint                socket_fd;
+    /* bytes kimtoy has not taken yet, flushed from socket_watch */
+    GByteArray         *socket_queue;
+    guint               socket_watch;
+    IBusPanelImpanelSink sink;
+    gpointer            sink_data;
+    /* last state sent to the panel */
+    GVariant           *last_lookup_table;
+    gint                last_lookup_cursor;
+    GVariant           *last_properties;
+    GHashTable         *last_property_map;
 };
 
 struct _IBusPanelImpanelClass {
@@ -57,6 +74,15 @@ ibus_panel_impanel_set_bus (IBusPanelImpanel *impanel,
     impanel->bus = bus;
 }
 
+void
+ibus_panel_impanel_set_sink (IBusPanelImpanel     *impanel,
+                             IBusPanelImpanelSink  sink,
+                             gpointer              user_data)
+{
+    impanel->sink = sink;
+    impanel->sink_data = user_data;
+}
+
 static GDBusNodeInfo *introspection_data = NULL;
 
 static guint owner_id;
@@ -520,9 +546,341 @@ on_name_lost (GDBusConnection *connection,
               const gchar     *name,
               gpointer         user_data)
 {
+    // hosted in kimtoy, never take the host process down
+    if (((IBusPanelImpanel *)user_data)->sink)
+        return;
     exit (1);
 }
 
+static void
+impanel_socket_close (IBusPanelImpanel *impanel)
+{
+    if (impanel->socket_watch) {
+        g_source_remove (impanel->socket_watch);
+        impanel->socket_watch = 0;
+    }
+    g_byte_array_set_size (impanel->socket_queue, 0);
+    if (impanel->socket_fd != -1) {
+        close (impanel->socket_fd);
+        impanel->socket_fd = -1;
+    }
+}
+
+// write what the socket takes without blocking, FALSE when kimtoy is gone
+static gboolean
+impanel_socket_flush (IBusPanelImpanel *impanel)
+{
+    GByteArray *queue = impanel->socket_queue;
+    while (queue->len > 0) {
+        gssize n = send (impanel->socket_fd, queue->data, queue->len,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        g_byte_array_remove_range (queue, 0, n);
+    }
+    return TRUE;
+}
+
+static gboolean
+impanel_socket_writable (GIOChannel   *channel,
+                         GIOCondition  condition,
+                         gpointer      user_data)
+{
+    IBusPanelImpanel *impanel = (IBusPanelImpanel *)user_data;
+
+    if (!(condition & (G_IO_ERR | G_IO_HUP)) && impanel_socket_flush (impanel)) {
+        if (impanel->socket_queue->len > 0)
+            return TRUE;
+        impanel->socket_watch = 0;
+        return FALSE;
+    }
+
+    impanel->socket_watch = 0;
+    impanel_socket_close (impanel);
+    return FALSE;
+}
+
+// block for a short while until everything queued is written
+static gboolean
+impanel_socket_drain (IBusPanelImpanel *impanel)
+{
+    gint64 deadline = g_get_monotonic_time () + IMPANEL_DRAIN_TIMEOUT * 1000;
+    while (impanel_socket_flush (impanel)) {
+        if (impanel->socket_queue->len == 0)
+            return TRUE;
+
+        struct pollfd pfd;
+        pfd.fd = impanel->socket_fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        gint timeout = (deadline - g_get_monotonic_time ()) / 1000;
+        if (timeout <= 0 || poll (&pfd, 1, timeout) == 0)
+            return FALSE;
+    }
+    return FALSE;
+}
+
+static void
+impanel_socket_connect (IBusPanelImpanel *impanel)
+{
+    impanel_socket_close (impanel);
+
+    const gchar *runtime_dir = g_getenv ("XDG_RUNTIME_DIR");
+    if (!runtime_dir)
+        return;
+
+    struct sockaddr_un addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if (g_snprintf (addr.sun_path, sizeof (addr.sun_path), "%s/%s",
+                    runtime_dir, IMPANEL_SOCKET_NAME) >= (gint) sizeof (addr.sun_path))
+        return;
+
+    gint fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return;
+
+    if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) == -1) {
+        // older kimtoy, stay on dbus
+        close (fd);
+        return;
+    }
+
+    impanel->socket_fd = fd;
+}
+
+static gint
+impanel_socket_type (const gchar *signal_name)
+{
+    static const struct {
+        const gchar *name;
+        gint type;
+    } types[] = {
+        { "ShowPreedit",             IMPANEL_SHOW_PREEDIT },
+        { "ShowAux",                 IMPANEL_SHOW_AUX },
+        { "ShowLookupTable",         IMPANEL_SHOW_LOOKUPTABLE },
+        { "UpdatePreeditText",       IMPANEL_UPDATE_PREEDIT_TEXT },
+        { "UpdatePreeditCaret",      IMPANEL_UPDATE_PREEDIT_CARET },
+        { "UpdateAux",               IMPANEL_UPDATE_AUX },
+        { "UpdateLookupTable",       IMPANEL_UPDATE_LOOKUPTABLE },
+        { "UpdateLookupTableCursor", IMPANEL_UPDATE_LOOKUPTABLE_CURSOR },
+        { "UpdateSpotLocation",      IMPANEL_UPDATE_SPOT_LOCATION },
+    };
+
+    guint i;
+    for (i = 0; i < G_N_ELEMENTS (types); i++) {
+        if (strcmp (types[i].name, signal_name) == 0)
+            return types[i].type;
+    }
+    return 0;
+}
+
+static void
+impanel_socket_append_uint32 (GByteArray *buffer, guint32 value)
+{
+    g_byte_array_append (buffer, (const guint8 *) &value, sizeof (value));
+}
+
+static gboolean
+impanel_socket_append_value (GByteArray *buffer, GVariant *value)
+{
+    if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN)) {
+        guint8 b = g_variant_get_boolean (value) ? 1 : 0;
+        g_byte_array_append (buffer, &b, 1);
+    }
+    else if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT32)) {
+        gint32 i = g_variant_get_int32 (value);
+        g_byte_array_append (buffer, (const guint8 *) &i, sizeof (i));
+    }
+    else if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING)) {
+        gsize size;
+        const gchar *str = g_variant_get_string (value, &size);
+        impanel_socket_append_uint32 (buffer, size);
+        g_byte_array_append (buffer, (const guint8 *) str, size);
+    }
+    else if (g_variant_is_container (value)) {
+        gsize i, n = g_variant_n_children (value);
+        // tuples are flattened, arrays carry their length
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE_ARRAY))
+            impanel_socket_append_uint32 (buffer, n);
+        for (i = 0; i < n; i++) {
+            GVariant *child = g_variant_get_child_value (value, i);
+            gboolean ok = impanel_socket_append_value (buffer, child);
+            g_variant_unref (child);
+            if (!ok)
+                return FALSE;
+        }
+    }
+    else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// queue one message, FALSE when it has to go over dbus instead
+static gboolean
+impanel_socket_send (IBusPanelImpanel *impanel,
+                     gint              type,
+                     GVariant         *parameters)
+{
+    GByteArray *queue = impanel->socket_queue;
+    guint start = queue->len;
+    impanel_socket_append_uint32 (queue, 0);
+    impanel_socket_append_uint32 (queue, type);
+
+    gboolean ok = impanel_socket_append_value (queue, parameters);
+    guint32 size = queue->len - start - 2 * sizeof (guint32);
+    if (!ok || size > IMPANEL_MAX_PAYLOAD) {
+        g_byte_array_set_size (queue, start);
+        return FALSE;
+    }
+    memcpy (queue->data + start, &size, sizeof (size));
+
+    if (queue->len > IMPANEL_MAX_QUEUE && !impanel_socket_drain (impanel)) {
+        // kimtoy stopped reading, the queued updates are stale anyway
+        impanel_socket_close (impanel);
+        return FALSE;
+    }
+    if (!impanel_socket_flush (impanel)) {
+        impanel_socket_close (impanel);
+        return FALSE;
+    }
+
+    if (queue->len > 0 && !impanel->socket_watch) {
+        GIOChannel *channel = g_io_channel_unix_new (impanel->socket_fd);
+        impanel->socket_watch = g_io_add_watch (channel, G_IO_OUT | G_IO_ERR | G_IO_HUP,
+                                                impanel_socket_writable, impanel);
+        g_io_channel_unref (channel);
+    }
+    return TRUE;
+}
+
+static void
+impanel_emit (IBusPanelImpanel *impanel,
+              const gchar      *signal_name,
+              GVariant         *parameters)
+{
+    g_variant_ref_sink (parameters);
+
+    if (impanel->sink) {
+        impanel->sink (signal_name, parameters, impanel->sink_data);
+        g_variant_unref (parameters);
+        return;
+    }
+
+    if (impanel->socket_fd != -1) {
+        gint type = impanel_socket_type (signal_name);
+        if (type && impanel_socket_send (impanel, type, parameters)) {
+            g_variant_unref (parameters);
+            return;
+        }
+        // too large for the socket, let the updates queued before it arrive first
+        if (type && impanel->socket_fd != -1 && !impanel_socket_drain (impanel))
+            impanel_socket_close (impanel);
+    }
+
+    g_dbus_connection_emit_signal (impanel->conn,
+                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", signal_name,
+                                   parameters,
+                                   NULL);
+    g_variant_unref (parameters);
+}
+
+static void
+impanel_forget_state (IBusPanelImpanel *impanel)
+{
+    if (impanel->last_lookup_table) {
+        g_variant_unref (impanel->last_lookup_table);
+        impanel->last_lookup_table = NULL;
+    }
+    impanel->last_lookup_cursor = -1;
+    if (impanel->last_properties) {
+        g_variant_unref (impanel->last_properties);
+        impanel->last_properties = NULL;
+    }
+    g_hash_table_remove_all (impanel->last_property_map);
+}
+
+/* returns TRUE if the property string differs from the last one sent with its key */
+static gboolean
+impanel_remember_property (IBusPanelImpanel *impanel,
+                           const gchar      *propstr)
+{
+    const gchar *colon = strchr (propstr, ':');
+    gchar *key = colon ? g_strndup (propstr, colon - propstr) : g_strdup (propstr);
+
+    const gchar *last = g_hash_table_lookup (impanel->last_property_map, key);
+    if (last && strcmp (last, propstr) == 0) {
+        g_free (key);
+        return FALSE;
+    }
+
+    g_hash_table_insert (impanel->last_property_map, key, g_strdup (propstr));
+    return TRUE;
+}
+
+static void
+impanel_emit_property (IBusPanelImpanel *impanel,
+                       const gchar      *propstr)
+{
+    if (!impanel_remember_property (impanel, propstr))
+        return;
+
+    impanel_emit (impanel, "UpdateProperty",
+                  g_variant_new ("(s)", propstr));
+}
+
+static void
+impanel_emit_properties (IBusPanelImpanel *impanel,
+                         GVariant         *properties)
+{
+    g_variant_ref_sink (properties);
+
+    if (impanel->last_properties && g_variant_equal (impanel->last_properties, properties)) {
+        g_variant_unref (properties);
+        return;
+    }
+
+    /* the same keys in the same order only need the changed entries */
+    gboolean same_keys = impanel->last_properties
+                         && g_variant_n_children (impanel->last_properties) == g_variant_n_children (properties);
+    gsize i, n = g_variant_n_children (properties);
+    for (i = 0; same_keys && i < n; i++) {
+        const gchar *a, *b;
+        g_variant_get_child (impanel->last_properties, i, "&s", &a);
+        g_variant_get_child (properties, i, "&s", &b);
+        const gchar *ca = strchr (a, ':');
+        const gchar *cb = strchr (b, ':');
+        gsize la = ca ? (gsize) (ca - a) : strlen (a);
+        gsize lb = cb ? (gsize) (cb - b) : strlen (b);
+        same_keys = la == lb && strncmp (a, b, la) == 0;
+    }
+
+    if (same_keys) {
+        for (i = 0; i < n; i++) {
+            const gchar *propstr;
+            g_variant_get_child (properties, i, "&s", &propstr);
+            impanel_emit_property (impanel, propstr);
+        }
+    }
+    else {
+        g_hash_table_remove_all (impanel->last_property_map);
+        for (i = 0; i < n; i++) {
+            const gchar *propstr;
+            g_variant_get_child (properties, i, "&s", &propstr);
+            impanel_remember_property (impanel, propstr);
+        }
+        impanel_emit (impanel, "RegisterProperties",
+                      g_variant_new_tuple (&properties, 1));
+    }
+
+    if (impanel->last_properties)
+        g_variant_unref (impanel->last_properties);
+    impanel->last_properties = properties;
+}
+
 static void
 on_name_appeared (GDBusConnection *connection,
                   const gchar     *name,
@@ -540,10 +898,14 @@ on_name_appeared (GDBusConnection *connection,
     ibus_property_to_propstr(((IBusPanelImpanel *)user_data)->about_prop, propstr, 512);
     g_variant_builder_add (&builder, "s", propstr);
 
-    g_dbus_connection_emit_signal (((IBusPanelImpanel *)user_data)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "RegisterProperties",
-                                   g_variant_new ("(as)", &builder),
-                                   NULL);
+    // a new panel knows nothing yet
+    impanel_forget_state ((IBusPanelImpanel *)user_data);
+    impanel_emit_properties ((IBusPanelImpanel *)user_data,
+                             g_variant_builder_end (&builder));
+
+    // preedit bar updates go over the private socket when kimtoy offers one
+    if (!((IBusPanelImpanel *)user_data)->sink)
+        impanel_socket_connect ((IBusPanelImpanel *)user_data);
 }
 
 static void
@@ -551,6 +913,7 @@ on_name_vanished (GDBusConnection *connection,
                   const gchar     *name,
                   gpointer         user_data)
 {
+    impanel_socket_close ((IBusPanelImpanel *)user_data);
 }
 
 #if !IBUS_CHECK_VERSION(1,3,99)
@@ -625,6 +988,13 @@ ibus_panel_impanel_init (IBusPanelImpanel *impanel)
 {
     impanel->bus = NULL;
     impanel->input_context = NULL;
+    impanel->socket_fd = -1;
+    impanel->socket_queue = g_byte_array_new ();
+    impanel->socket_watch = 0;
+    impanel->last_lookup_table = NULL;
+    impanel->last_lookup_cursor = -1;
+    impanel->last_properties = NULL;
+    impanel->last_property_map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
     introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
     owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
@@ -673,6 +1043,12 @@ ibus_panel_impanel_destroy (IBusPanelImpanel *impanel)
     g_object_unref (impanel->about_prop);
     impanel->about_prop = NULL;
 
+    impanel_socket_close (impanel);
+    g_byte_array_free (impanel->socket_queue, TRUE);
+    impanel->socket_queue = NULL;
+    impanel_forget_state (impanel);
+    g_hash_table_unref (impanel->last_property_map);
+    impanel->last_property_map = NULL;
     g_bus_unwatch_name (watcher_id);
     g_bus_unown_name (owner_id);
     g_dbus_node_info_unref (introspection_data);
@@ -743,10 +1119,7 @@ ibus_panel_impanel_focus_in (IBusPanelService *panel,
 
     ibus_property_to_propstr(IBUS_PANEL_IMPANEL (panel)->logo_prop, propstr, 512);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateProperty",
-                                   g_variant_new ("(s)", propstr),
-                                   NULL);
+    impanel_emit_property (IBUS_PANEL_IMPANEL (panel), propstr);
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -798,10 +1171,8 @@ ibus_panel_impanel_register_properties (IBusPanelService *panel,
     ibus_property_to_propstr(IBUS_PANEL_IMPANEL (panel)->about_prop, propstr, 512);
     g_variant_builder_add (&builder, "s", propstr);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "RegisterProperties",
-                                   g_variant_new ("(as)", &builder),
-                                   NULL);
+    impanel_emit_properties (IBUS_PANEL_IMPANEL (panel),
+                             g_variant_builder_end (&builder));
 
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
@@ -828,10 +1199,8 @@ ibus_panel_impanel_set_cursor_location (IBusPanelService *panel,
     gint sx = x + w;
     gint sy = y + h;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateSpotLocation",
-                                   g_variant_new ("(ii)", sx, sy),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "UpdateSpotLocation",
+                  g_variant_new ("(ii)", sx, sy));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -865,10 +1234,8 @@ ibus_panel_impanel_update_auxiliary_text (IBusPanelService *panel,
     gchar attrliststr[128];// WARNING large enough I think --- nihui
     ibus_attribute_list_to_attrliststr (attrs, attrliststr, 128);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateAux",
-                                   g_variant_new ("(ss)", t, attrliststr),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "UpdateAux",
+                  g_variant_new ("(ss)", t, attrliststr));
 
     if (visible == 0)
 #if !IBUS_CHECK_VERSION(1,3,99)
@@ -953,21 +1320,33 @@ ibus_panel_impanel_update_lookup_table (IBusPanelService *panel,
     gboolean has_prev = start > 0;
     gboolean has_next = num > end;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateLookupTable",
-                                   g_variant_new ("(asasasbb)",
-                                                  &builder_labels,
-                                                  &builder_candidates,
-                                                  &builder_attrs,
-                                                  has_prev, has_next),
-                                   NULL);
+    IBusPanelImpanel *impanel = IBUS_PANEL_IMPANEL (panel);
 
-    guint cursor_pos_in_page = cursor_pos % page_size;
+    GVariant *table = g_variant_ref_sink (g_variant_new ("(asasasbb)",
+                                                         &builder_labels,
+                                                         &builder_candidates,
+                                                         &builder_attrs,
+                                                         has_prev, has_next));
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateLookupTableCursor",
-                                   g_variant_new ("(i)", cursor_pos_in_page),
-                                   NULL);
+    // moving the highlight within a page only needs the cursor
+    if (impanel->last_lookup_table && g_variant_equal (impanel->last_lookup_table, table)) {
+        g_variant_unref (table);
+    }
+    else {
+        impanel_emit (impanel, "UpdateLookupTable", table);
+        if (impanel->last_lookup_table)
+            g_variant_unref (impanel->last_lookup_table);
+        impanel->last_lookup_table = table;
+        impanel->last_lookup_cursor = -1;
+    }
+
+    gint cursor_pos_in_page = cursor_pos % page_size;
+
+    if (impanel->last_lookup_cursor != cursor_pos_in_page) {
+        impanel_emit (impanel, "UpdateLookupTableCursor",
+                      g_variant_new ("(i)", cursor_pos_in_page));
+        impanel->last_lookup_cursor = cursor_pos_in_page;
+    }
 
     if (visible == 0)
 #if !IBUS_CHECK_VERSION(1,3,99)
@@ -1016,15 +1395,11 @@ ibus_panel_impanel_update_preedit_text (IBusPanelService *panel,
     gchar attrliststr[128];// WARNING large enough I think --- nihui
     ibus_attribute_list_to_attrliststr (attrs, attrliststr, 128);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdatePreeditText",
-                                   g_variant_new ("(ss)", t, attrliststr),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "UpdatePreeditText",
+                  g_variant_new ("(ss)", t, attrliststr));
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdatePreeditCaret",
-                                   g_variant_new ("(i)", cursor_pos),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "UpdatePreeditCaret",
+                  g_variant_new ("(i)", cursor_pos));
 
     if (visible == 0)
 #if !IBUS_CHECK_VERSION(1,3,99)
@@ -1058,10 +1433,7 @@ ibus_panel_impanel_update_property (IBusPanelService *panel,
 
     ibus_property_to_propstr(prop, propstr, 512);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateProperty",
-                                   g_variant_new ("(s)", propstr),
-                                   NULL);
+    impanel_emit_property (IBUS_PANEL_IMPANEL (panel), propstr);
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1106,10 +1478,8 @@ ibus_panel_impanel_hide_auxiliary_text (IBusPanelService *panel)
 {
     gboolean toShow = 0;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowAux",
-                                   g_variant_new ("(b)", toShow),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ShowAux",
+                  g_variant_new ("(b)", toShow));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1140,10 +1510,8 @@ ibus_panel_impanel_hide_lookup_table (IBusPanelService *panel)
 {
     gboolean toShow = 0;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowLookupTable",
-                                   g_variant_new ("(b)", toShow),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ShowLookupTable",
+                  g_variant_new ("(b)", toShow));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1160,10 +1528,8 @@ ibus_panel_impanel_hide_preedit_text (IBusPanelService *panel)
 {
     gboolean toShow = 0;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowPreedit",
-                                   g_variant_new ("(b)", toShow),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ShowPreedit",
+                  g_variant_new ("(b)", toShow));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1222,10 +1588,8 @@ ibus_panel_impanel_show_auxiliary_text (IBusPanelService *panel)
 {
     gboolean toShow = 1;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowAux",
-                                   g_variant_new ("(b)", toShow),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ShowAux",
+                  g_variant_new ("(b)", toShow));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1256,10 +1620,8 @@ ibus_panel_impanel_show_lookup_table (IBusPanelService *panel)
 {
     gboolean toShow = 1;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowLookupTable",
-                                   g_variant_new ("(b)", toShow),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ShowLookupTable",
+                  g_variant_new ("(b)", toShow));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1276,10 +1638,8 @@ ibus_panel_impanel_show_preedit_text (IBusPanelService *panel)
 {
     gboolean toShow = 1;
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowPreedit",
-                                   g_variant_new ("(b)", toShow),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ShowPreedit",
+                  g_variant_new ("(b)", toShow));
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
 #endif
@@ -1343,16 +1703,11 @@ ibus_panel_impanel_state_changed (IBusPanelService *panel)
 
     ibus_property_to_propstr(IBUS_PANEL_IMPANEL (panel)->logo_prop, propstr, 512);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateProperty",
-                                   g_variant_new ("(s)", propstr),
-                                   NULL);
+    impanel_emit_property (IBUS_PANEL_IMPANEL (panel), propstr);
 
 #if !IBUS_CHECK_VERSION(1,4,99)
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "Enable",
-                                   g_variant_new ("(b)", enable),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "Enable",
+                  g_variant_new ("(b)", enable));
 #endif
 #if !IBUS_CHECK_VERSION(1,3,99)
     return TRUE;
@@ -1366,10 +1721,8 @@ ibus_panel_impanel_exec_dialog (IBusPanelService *panel)
 
     ibus_property_to_propstr(IBUS_PANEL_IMPANEL (panel)->about_prop, propstr, 512);
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ExecDialog",
-                                   g_variant_new ("(s)", propstr),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ExecDialog",
+                  g_variant_new ("(s)", propstr));
 }
 
 static void
@@ -1434,10 +1787,8 @@ ibus_panel_impanel_exec_menu (IBusPanelService *panel)
 
 #endif
 
-    g_dbus_connection_emit_signal (IBUS_PANEL_IMPANEL (panel)->conn,
-                                   NULL, "/kimpanel", "org.kde.kimpanel.inputmethod", "ExecMenu",
-                                   g_variant_new ("(as)", &builder),
-                                   NULL);
+    impanel_emit (IBUS_PANEL_IMPANEL (panel), "ExecMenu",
+                  g_variant_new ("(as)", &builder));
 }
 
 IBusPanelImpanel *
@@ -24,6 +24,8 @@
 
 #include <ibus.h>
 
+G_BEGIN_DECLS
+
 #define IBUS_TYPE_PANEL_IMPANEL        \
     (ibus_panel_impanel_get_type ())
 #define IBUS_PANEL_IMPANEL(obj)            \
@@ -39,6 +41,11 @@
 
 typedef struct _IBusPanelImpanel IBusPanelImpanel;
 
+/* receives the kimpanel signals instead of the session bus */
+typedef void (*IBusPanelImpanelSink) (const gchar *signal_name,
+                                      GVariant    *parameters,
+                                      gpointer     user_data);
+
 GType               ibus_panel_impanel_get_type     (void);
 #if !IBUS_CHECK_VERSION(1,3,99)
 IBusPanelImpanel   *ibus_panel_impanel_new          (IBusConnection     *connection);
@@ -47,5 +54,10 @@ IBusPanelImpanel   *ibus_panel_impanel_new          (GDBusConnection    *connect
 #endif
 void                ibus_panel_impanel_set_bus      (IBusPanelImpanel   *impanel,
                                                      IBusBus            *bus);
+void                ibus_panel_impanel_set_sink     (IBusPanelImpanel   *impanel,
+                                                     IBusPanelImpanelSink sink,
+                                                     gpointer            user_data);
+
+G_END_DECLS
 
 #endif
@@ -0,0 +1,209 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+/// gio has members named signals, include it before qt defines the keyword
+#include "ibus-panel/panel.h"
+#if !IBUS_CHECK_VERSION(1,3,99)
+/// panel.c only hands out a gdbus connection since 1.3.99
+#undef KIMTOY_HAVE_IBUS_PANEL
+#endif
+#endif
+
+#include "ibuspanel.h"
+
+#include <QAbstractEventDispatcher>
+
+IBusPanel* IBusPanel::m_self = 0;
+
+IBusPanel* IBusPanel::self()
+{
+    if (!m_self)
+        m_self = new IBusPanel;
+    return m_self;
+}
+
+IBusPanel::IBusPanel()
+{
+    m_bus = 0;
+    m_impanel = 0;
+}
+
+IBusPanel::~IBusPanel()
+{
+    stop();
+}
+
+bool IBusPanel::isAvailable() const
+{
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+    /// gdbus callbacks are only delivered if qt iterates the default main context
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    return dispatcher && dispatcher->inherits("QEventDispatcherGlib");
+#else
+    return false;
+#endif
+}
+
+bool IBusPanel::isRunning() const
+{
+    return m_bus;
+}
+
+void IBusPanel::start()
+{
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+    if (m_bus || !isAvailable())
+        return;
+
+    ibus_init();
+    m_bus = ibus_bus_new();
+    /// the daemon may still be starting up, ibus reconnects on its own
+    g_signal_connect(m_bus, "connected", G_CALLBACK(busConnected), this);
+    if (ibus_bus_is_connected(m_bus))
+        createPanel();
+#endif
+}
+
+void IBusPanel::stop()
+{
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+    if (m_impanel) {
+        ibus_object_destroy(IBUS_OBJECT(m_impanel));
+        g_object_unref(m_impanel);
+        m_impanel = 0;
+    }
+    if (m_bus) {
+        g_signal_handlers_disconnect_by_data(m_bus, this);
+        g_object_unref(m_bus);
+        m_bus = 0;
+    }
+#endif
+}
+
+void IBusPanel::busConnected(struct _IBusBus* bus, void* user_data)
+{
+    Q_UNUSED(bus)
+    static_cast<IBusPanel*>(user_data)->createPanel();
+}
+
+void IBusPanel::createPanel()
+{
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+    /// a restarted daemon needs a new service on the new connection
+    if (m_impanel) {
+        ibus_object_destroy(IBUS_OBJECT(m_impanel));
+        g_object_unref(m_impanel);
+    }
+    m_impanel = ibus_panel_impanel_new(ibus_bus_get_connection(m_bus));
+    g_object_ref_sink(m_impanel);
+    ibus_panel_impanel_set_sink(m_impanel, sink, this);
+    ibus_panel_impanel_set_bus(m_impanel, m_bus);
+    ibus_bus_request_name(m_bus, IBUS_SERVICE_PANEL, 0);
+#endif
+}
+
+void IBusPanel::sink(const char* signalName, struct _GVariant* parameters, void* user_data)
+{
+    static_cast<IBusPanel*>(user_data)->dispatch(signalName, parameters);
+}
+
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+static bool argBool(GVariant* parameters, int index)
+{
+    GVariant* child = g_variant_get_child_value(parameters, index);
+    bool value = g_variant_get_boolean(child);
+    g_variant_unref(child);
+    return value;
+}
+
+static int argInt(GVariant* parameters, int index)
+{
+    GVariant* child = g_variant_get_child_value(parameters, index);
+    int value = g_variant_get_int32(child);
+    g_variant_unref(child);
+    return value;
+}
+
+static QString argString(GVariant* parameters, int index)
+{
+    GVariant* child = g_variant_get_child_value(parameters, index);
+    QString value = QString::fromUtf8(g_variant_get_string(child, 0));
+    g_variant_unref(child);
+    return value;
+}
+
+static QStringList argStringList(GVariant* parameters, int index)
+{
+    GVariant* child = g_variant_get_child_value(parameters, index);
+    QStringList value;
+    gsize count = g_variant_n_children(child);
+    for (gsize i = 0; i < count; ++i) {
+        value << argString(child, i);
+    }
+    g_variant_unref(child);
+    return value;
+}
+#endif
+
+void IBusPanel::dispatch(const char* signalName, struct _GVariant* parameters)
+{
+#ifdef KIMTOY_HAVE_IBUS_PANEL
+    const QByteArray name(signalName);
+    if (name == "UpdatePreeditText")
+        emit UpdatePreeditText(argString(parameters, 0), argString(parameters, 1));
+    else if (name == "UpdatePreeditCaret")
+        emit UpdatePreeditCaret(argInt(parameters, 0));
+    else if (name == "UpdateAux")
+        emit UpdateAux(argString(parameters, 0), argString(parameters, 1));
+    else if (name == "UpdateLookupTable")
+        emit UpdateLookupTable(argStringList(parameters, 0),
+                               argStringList(parameters, 1),
+                               argStringList(parameters, 2),
+                               argBool(parameters, 3),
+                               argBool(parameters, 4));
+    else if (name == "UpdateLookupTableCursor")
+        emit UpdateLookupTableCursor(argInt(parameters, 0));
+    else if (name == "UpdateSpotLocation")
+        emit UpdateSpotLocation(argInt(parameters, 0), argInt(parameters, 1));
+    else if (name == "ShowPreedit")
+        emit ShowPreedit(argBool(parameters, 0));
+    else if (name == "ShowAux")
+        emit ShowAux(argBool(parameters, 0));
+    else if (name == "ShowLookupTable")
+        emit ShowLookupTable(argBool(parameters, 0));
+    else if (name == "Enable")
+        emit Enable(argBool(parameters, 0));
+    else if (name == "RegisterProperties")
+        emit RegisterProperties(argStringList(parameters, 0));
+    else if (name == "UpdateProperty")
+        emit UpdateProperty(argString(parameters, 0));
+    else if (name == "RemoveProperty")
+        emit RemoveProperty(argString(parameters, 0));
+    else if (name == "ExecDialog")
+        emit ExecDialog(argString(parameters, 0));
+    else if (name == "ExecMenu")
+        emit ExecMenu(argStringList(parameters, 0));
+#else
+    Q_UNUSED(signalName)
+    Q_UNUSED(parameters)
+#endif
+}
@@ -0,0 +1,80 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IBUSPANEL_H
+#define IBUSPANEL_H
+
+#include <QObject>
+#include <QStringList>
+
+struct _GVariant;
+struct _IBusBus;
+struct _IBusPanelImpanel;
+
+/**
+ * IBus panel service hosted inside KIMToy
+ *
+ * Runs ibus-panel/panel.c on the GLib main context driven by the Qt event
+ * loop and emits its kimpanel signals directly instead of over the bus.
+ */
+class IBusPanel : public QObject
+{
+    Q_OBJECT
+public:
+    static IBusPanel* self();
+    virtual ~IBusPanel();
+    /// built with ibus and running on the glib event dispatcher
+    bool isAvailable() const;
+    bool isRunning() const;
+    void start();
+    void stop();
+Q_SIGNALS:
+    void Enable(bool enable);
+    void RegisterProperties(const QStringList& props);
+    void UpdateProperty(const QString& prop);
+    void RemoveProperty(const QString& prop);
+    void ExecDialog(const QString& prop);
+    void ExecMenu(const QStringList& entries);
+    void ShowPreedit(bool toshow);
+    void ShowAux(bool toshow);
+    void ShowLookupTable(bool toshow);
+    void UpdatePreeditText(const QString& text, const QString& attr);
+    void UpdatePreeditCaret(int pos);
+    void UpdateAux(const QString& text, const QString& attr);
+    void UpdateLookupTable(const QStringList& labels,
+                           const QStringList& candidates,
+                           const QStringList& attrs,
+                           bool hasPrev,
+                           bool hasNext);
+    void UpdateLookupTableCursor(int pos);
+    void UpdateSpotLocation(int x, int y);
+private:
+    static void busConnected(struct _IBusBus* bus, void* user_data);
+    static void sink(const char* signalName, struct _GVariant* parameters, void* user_data);
+    void createPanel();
+    void dispatch(const char* signalName, struct _GVariant* parameters);
+    struct _IBusBus* m_bus;
+    struct _IBusPanelImpanel* m_impanel;
+    explicit IBusPanel();
+    static IBusPanel* m_self;
+};
+
+#endif // IBUSPANEL_H
@@ -21,12 +21,20 @@
 
 #include "impanel.h"
 
+#include <KWindowInfo>
+#include <KWindowSystem>
+
 #include "impaneladaptor.h"
+#include "impanel2adaptor.h"
+#include "impanelsocket.h"
 
 IMPanel::IMPanel(QObject* parent)
         : QObject(parent)
 {
     new IMPanelAdaptor(this);
+    new IMPanel2Adaptor(this);
+    /// listen before the service shows up so bridges find the socket
+    m_socket = new IMPanelSocket(this);
     QDBusConnection connection = QDBusConnection::sessionBus();
     connection.registerService("org.kde.impanel");
     connection.registerObject("/org/kde/impanel", this);
@@ -35,3 +43,34 @@ IMPanel::IMPanel(QObject* parent)
 IMPanel::~IMPanel()
 {
 }
+
+IMPanelSocket* IMPanel::socket() const
+{
+    return m_socket;
+}
+
+void IMPanel::SetSpotRect(int x, int y, int w, int h)
+{
+    emit spotRectChanged(x, y, w, h);
+}
+
+void IMPanel::SetRelativeSpotRect(int x, int y, int w, int h)
+{
+    /// relative to the active window
+    KWindowInfo info(KWindowSystem::activeWindow(), NET::WMGeometry);
+    QPoint origin = info.valid() ? info.geometry().topLeft() : QPoint(0, 0);
+    emit spotRectChanged(origin.x() + x, origin.y() + y, w, h);
+}
+
+void IMPanel::SetLookupTable(const QStringList& labels,
+                             const QStringList& candidates,
+                             const QStringList& attrs,
+                             bool hasPrev,
+                             bool hasNext,
+                             int cursor,
+                             int layout)
+{
+    /// the panel orientation follows the user setting
+    Q_UNUSED(layout)
+    emit lookupTableChanged(labels, candidates, attrs, hasPrev, hasNext, cursor);
+}
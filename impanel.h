@@ -23,6 +23,9 @@
 #define IMPANEL_H
 
 #include <QObject>
+#include <QStringList>
+
+class IMPanelSocket;
 
 class IMPanel : public QObject
 {
@@ -30,6 +33,19 @@ class IMPanel : public QObject
 public:
     explicit IMPanel(QObject* parent = 0);
     virtual ~IMPanel();
+    /// private bridge transport, the kimpanel signals without D-Bus
+    IMPanelSocket* socket() const;
+public Q_SLOTS:
+    /// kimpanel v2 requests from the input method
+    void SetSpotRect(int x, int y, int w, int h);
+    void SetRelativeSpotRect(int x, int y, int w, int h);
+    void SetLookupTable(const QStringList& labels,
+                        const QStringList& candidates,
+                        const QStringList& attrs,
+                        bool hasPrev,
+                        bool hasNext,
+                        int cursor,
+                        int layout);
 Q_SIGNALS:
     void MovePreeditCaret(int pos);
     void SelectCandidate(int index);
@@ -40,6 +56,18 @@ Q_SIGNALS:
     void Exit();
     void ReloadConfig();
     void Configure();
+    void PanelCreated2();
+
+    /// spot rectangle in screen coordinates
+    void spotRectChanged(int x, int y, int w, int h);
+    void lookupTableChanged(const QStringList& labels,
+                            const QStringList& candidates,
+                            const QStringList& attrs,
+                            bool hasPrev,
+                            bool hasNext,
+                            int cursor);
+private:
+    IMPanelSocket* m_socket;
 };
 
 #endif // IMPANEL_H
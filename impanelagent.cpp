@@ -22,6 +22,17 @@
 #include "impanelagent.h"
 
 #include "impanelagent_p.h"
+#include "impanelsocket.h"
+
+QObject* IMPanelAgent::panel()
+{
+    return IMPanelAgentPrivate::self();
+}
+
+QObject* IMPanelAgent::socket()
+{
+    return IMPanelAgentPrivate::self()->socket();
+}
 
 void IMPanelAgent::MovePreeditCaret(int pos)
 {
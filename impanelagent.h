@@ -24,8 +24,15 @@
 
 #include <QString>
 
+class QObject;
+
 namespace IMPanelAgent
 {
+/// emits spotRectChanged and lookupTableChanged for kimpanel v2 requests
+QObject* panel();
+/// emits the kimpanel inputmethod signals received over the bridge socket
+QObject* socket();
+
 void MovePreeditCaret(int pos);
 void SelectCandidate(int index);
 void LookupTablePageUp();
@@ -58,6 +58,8 @@ void IMPanelAgentPrivate::pTriggerProperty(const QString& objectPath)
 void IMPanelAgentPrivate::pPanelCreated()
 {
     emit PanelCreated();
+    /// announce the kimpanel v2 methods
+    emit PanelCreated2();
 }
 
 void IMPanelAgentPrivate::pExit()
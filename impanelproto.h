@@ -0,0 +1,65 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMPANELPROTO_H
+#define IMPANELPROTO_H
+
+/*
+ * Private transport between the bundled ibus/scim panel bridges and KIMToy.
+ *
+ * KIMToy listens on the unix socket IMPANEL_SOCKET_NAME in $XDG_RUNTIME_DIR
+ * before it registers org.kde.impanel. A bridge connects to it whenever the
+ * panel appears and sends the preedit bar updates through it. Bytes KIMToy
+ * does not take right away are queued, the socket is only closed when KIMToy
+ * is gone or stops reading, and the bridge then falls back to the kimpanel
+ * D-Bus signals. A message too large for the socket goes over D-Bus once the
+ * queue in front of it is drained, so KIMToy sees the updates in order.
+ *
+ * Every message is a header of two host order uint32, the payload size and
+ * the message type, followed by the payload. In the payload an int is a host
+ * order int32, a bool one byte, a string a uint32 byte count and the UTF-8
+ * bytes, a string list a uint32 count and the strings.
+ */
+
+#define IMPANEL_SOCKET_NAME "kimtoy-impanel"
+
+/* upper bound of a single payload */
+#define IMPANEL_MAX_PAYLOAD (1024 * 1024)
+
+/* upper bound of bytes queued for a KIMToy that does not read */
+#define IMPANEL_MAX_QUEUE (4 * IMPANEL_MAX_PAYLOAD)
+
+/* milliseconds a bridge blocks waiting for the queue to drain */
+#define IMPANEL_DRAIN_TIMEOUT 50
+
+enum {
+    IMPANEL_SHOW_PREEDIT = 1,           /* bool toshow */
+    IMPANEL_SHOW_AUX,                   /* bool toshow */
+    IMPANEL_SHOW_LOOKUPTABLE,           /* bool toshow */
+    IMPANEL_UPDATE_PREEDIT_TEXT,        /* string text, string attr */
+    IMPANEL_UPDATE_PREEDIT_CARET,       /* int pos */
+    IMPANEL_UPDATE_AUX,                 /* string text, string attr */
+    IMPANEL_UPDATE_LOOKUPTABLE,         /* strings labels, strings candidates, strings attrs, bool hasprev, bool hasnext */
+    IMPANEL_UPDATE_LOOKUPTABLE_CURSOR,  /* int pos */
+    IMPANEL_UPDATE_SPOT_LOCATION        /* int x, int y */
+};
+
+#endif /* IMPANELPROTO_H */
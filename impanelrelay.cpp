@@ -0,0 +1,129 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "impanelrelay.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+
+#include "ibuspanel.h"
+#include "impanelagent.h"
+
+IMPanelRelay* IMPanelRelay::m_self = 0;
+
+IMPanelRelay* IMPanelRelay::self()
+{
+    if (!m_self)
+        m_self = new IMPanelRelay;
+    return m_self;
+}
+
+IMPanelRelay::IMPanelRelay()
+{
+    /// ibus and fcitx own the first name, the scim bridge the second
+    QStringList services;
+    services << "org.kde.kimpanel.inputmethod" << "org.kde.impanel.inputmethod";
+
+    /// an empty signal name matches the whole interface, the bus daemon
+    /// resolves the sender against the current owner of the name
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    foreach (const QString& service, services) {
+        connection.connect(service, "/kimpanel", "org.kde.kimpanel.inputmethod", QString(),
+                           this, SLOT(slotSignal(QDBusMessage)));
+    }
+
+    relay(IMPanelAgent::socket());
+    relay(IBusPanel::self());
+}
+
+IMPanelRelay::~IMPanelRelay()
+{
+}
+
+void IMPanelRelay::relay(QObject* source)
+{
+    /// signals of the same name and signature pass straight through
+    static const char* const signatures[] = {
+        SIGNAL(Enable(bool)),
+        SIGNAL(RegisterProperties(QStringList)),
+        SIGNAL(UpdateProperty(QString)),
+        SIGNAL(RemoveProperty(QString)),
+        SIGNAL(ExecDialog(QString)),
+        SIGNAL(ExecMenu(QStringList)),
+        SIGNAL(ShowPreedit(bool)),
+        SIGNAL(ShowAux(bool)),
+        SIGNAL(ShowLookupTable(bool)),
+        SIGNAL(UpdatePreeditText(QString,QString)),
+        SIGNAL(UpdatePreeditCaret(int)),
+        SIGNAL(UpdateAux(QString,QString)),
+        SIGNAL(UpdateLookupTable(QStringList,QStringList,QStringList,bool,bool)),
+        SIGNAL(UpdateLookupTableCursor(int)),
+        SIGNAL(UpdateSpotLocation(int,int))
+    };
+    const int count = sizeof(signatures) / sizeof(signatures[0]);
+    for (int i = 0; i < count; ++i) {
+        /// skip the ones the source does not have, e.g. properties on the socket
+        if (source->metaObject()->indexOfSignal(signatures[i] + 1) == -1)
+            continue;
+        connect(source, signatures[i], this, signatures[i]);
+    }
+}
+
+void IMPanelRelay::slotSignal(const QDBusMessage& message)
+{
+    const QString member = message.member();
+    const QList<QVariant> args = message.arguments();
+
+    if (member == "UpdatePreeditText" && args.count() == 2)
+        emit UpdatePreeditText(args.at(0).toString(), args.at(1).toString());
+    else if (member == "UpdatePreeditCaret" && args.count() == 1)
+        emit UpdatePreeditCaret(args.at(0).toInt());
+    else if (member == "UpdateAux" && args.count() == 2)
+        emit UpdateAux(args.at(0).toString(), args.at(1).toString());
+    else if (member == "UpdateLookupTable" && args.count() == 5)
+        emit UpdateLookupTable(args.at(0).toStringList(),
+                               args.at(1).toStringList(),
+                               args.at(2).toStringList(),
+                               args.at(3).toBool(),
+                               args.at(4).toBool());
+    else if (member == "UpdateLookupTableCursor" && args.count() == 1)
+        emit UpdateLookupTableCursor(args.at(0).toInt());
+    else if (member == "UpdateSpotLocation" && args.count() == 2)
+        emit UpdateSpotLocation(args.at(0).toInt(), args.at(1).toInt());
+    else if (member == "ShowPreedit" && args.count() == 1)
+        emit ShowPreedit(args.at(0).toBool());
+    else if (member == "ShowAux" && args.count() == 1)
+        emit ShowAux(args.at(0).toBool());
+    else if (member == "ShowLookupTable" && args.count() == 1)
+        emit ShowLookupTable(args.at(0).toBool());
+    else if (member == "Enable" && args.count() == 1)
+        emit Enable(args.at(0).toBool());
+    else if (member == "RegisterProperties" && args.count() == 1)
+        emit RegisterProperties(args.at(0).toStringList());
+    else if (member == "UpdateProperty" && args.count() == 1)
+        emit UpdateProperty(args.at(0).toString());
+    else if (member == "RemoveProperty" && args.count() == 1)
+        emit RemoveProperty(args.at(0).toString());
+    else if (member == "ExecDialog" && args.count() == 1)
+        emit ExecDialog(args.at(0).toString());
+    else if (member == "ExecMenu" && args.count() == 1)
+        emit ExecMenu(args.at(0).toStringList());
+}
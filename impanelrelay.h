@@ -0,0 +1,71 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMPANELRELAY_H
+#define IMPANELRELAY_H
+
+#include <QObject>
+#include <QStringList>
+
+class QDBusMessage;
+
+/**
+ * Single source of the org.kde.kimpanel.inputmethod signals
+ *
+ * Merges the session bus, the bridge socket and the in-process ibus panel.
+ * On the bus only the well-known input method names are matched, with one
+ * rule per name that stays installed for the whole session.
+ */
+class IMPanelRelay : public QObject
+{
+    Q_OBJECT
+public:
+    static IMPanelRelay* self();
+    virtual ~IMPanelRelay();
+Q_SIGNALS:
+    void Enable(bool enable);
+    void RegisterProperties(const QStringList& props);
+    void UpdateProperty(const QString& prop);
+    void RemoveProperty(const QString& prop);
+    void ExecDialog(const QString& prop);
+    void ExecMenu(const QStringList& entries);
+    void ShowPreedit(bool toshow);
+    void ShowAux(bool toshow);
+    void ShowLookupTable(bool toshow);
+    void UpdatePreeditText(const QString& text, const QString& attr);
+    void UpdatePreeditCaret(int pos);
+    void UpdateAux(const QString& text, const QString& attr);
+    void UpdateLookupTable(const QStringList& labels,
+                           const QStringList& candidates,
+                           const QStringList& attrs,
+                           bool hasPrev,
+                           bool hasNext);
+    void UpdateLookupTableCursor(int pos);
+    void UpdateSpotLocation(int x, int y);
+private Q_SLOTS:
+    void slotSignal(const QDBusMessage& message);
+private:
+    void relay(QObject* source);
+    explicit IMPanelRelay();
+    static IMPanelRelay* m_self;
+};
+
+#endif // IMPANELRELAY_H
@@ -0,0 +1,225 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "impanelsocket.h"
+
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <string.h>
+
+#include "impanelproto.h"
+
+/**
+ * sequential reader of a message payload
+ */
+class PayloadReader
+{
+public:
+    explicit PayloadReader(const QByteArray& payload) : m_payload(payload), m_pos(0), m_ok(true) {}
+    bool ok() const {
+        return m_ok && m_pos == m_payload.size();
+    }
+    bool readBool() {
+        if (!require(1))
+            return false;
+        return m_payload.at(m_pos++) != 0;
+    }
+    int readInt() {
+        qint32 value = 0;
+        if (require(sizeof(value))) {
+            memcpy(&value, m_payload.constData() + m_pos, sizeof(value));
+            m_pos += sizeof(value);
+        }
+        return value;
+    }
+    QString readString() {
+        quint32 size = readInt();
+        if (!require(size))
+            return QString();
+        QString value = QString::fromUtf8(m_payload.constData() + m_pos, size);
+        m_pos += size;
+        return value;
+    }
+    QStringList readStringList() {
+        quint32 count = readInt();
+        QStringList value;
+        for (quint32 i = 0; i < count && m_ok; ++i) {
+            value << readString();
+        }
+        return value;
+    }
+private:
+    bool require(quint32 size) {
+        if ((quint32)(m_payload.size() - m_pos) < size)
+            m_ok = false;
+        return m_ok;
+    }
+    const QByteArray& m_payload;
+    int m_pos;
+    bool m_ok;
+};
+
+IMPanelSocket::IMPanelSocket(QObject* parent)
+        : QObject(parent)
+{
+    m_server = 0;
+
+    /// bridges only look into the runtime directory
+    QByteArray runtimeDir = qgetenv("XDG_RUNTIME_DIR");
+    if (runtimeDir.isEmpty())
+        return;
+
+    QString path = QDir(QString::fromLocal8Bit(runtimeDir)).filePath(IMPANEL_SOCKET_NAME);
+    QLocalServer::removeServer(path);
+
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(path)) {
+        delete m_server;
+        m_server = 0;
+        return;
+    }
+
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(slotNewConnection()));
+}
+
+IMPanelSocket::~IMPanelSocket()
+{
+}
+
+void IMPanelSocket::slotNewConnection()
+{
+    while (QLocalSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(slotDisconnected()));
+        m_buffers.insert(socket, QByteArray());
+    }
+}
+
+void IMPanelSocket::slotReadyRead()
+{
+    QLocalSocket* socket = static_cast<QLocalSocket*>(sender());
+    QByteArray& buffer = m_buffers[ socket ];
+    buffer.append(socket->readAll());
+
+    const int headerSize = 2 * sizeof(quint32);
+    int pos = 0;
+    while (buffer.size() - pos >= headerSize) {
+        quint32 header[2];
+        memcpy(header, buffer.constData() + pos, headerSize);
+        if (header[0] > IMPANEL_MAX_PAYLOAD) {
+            /// garbage, the bridge falls back to D-Bus
+            socket->abort();
+            return;
+        }
+        if ((quint32)(buffer.size() - pos - headerSize) < header[0])
+            break;
+
+        QByteArray payload = buffer.mid(pos + headerSize, header[0]);
+        pos += headerSize + header[0];
+        if (!dispatch(header[1], payload)) {
+            socket->abort();
+            return;
+        }
+    }
+    buffer.remove(0, pos);
+}
+
+void IMPanelSocket::slotDisconnected()
+{
+    QLocalSocket* socket = static_cast<QLocalSocket*>(sender());
+    m_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+bool IMPanelSocket::dispatch(quint32 type, const QByteArray& payload)
+{
+    PayloadReader r(payload);
+    switch (type) {
+        case IMPANEL_SHOW_PREEDIT: {
+            bool toshow = r.readBool();
+            if (r.ok())
+                emit ShowPreedit(toshow);
+            break;
+        }
+        case IMPANEL_SHOW_AUX: {
+            bool toshow = r.readBool();
+            if (r.ok())
+                emit ShowAux(toshow);
+            break;
+        }
+        case IMPANEL_SHOW_LOOKUPTABLE: {
+            bool toshow = r.readBool();
+            if (r.ok())
+                emit ShowLookupTable(toshow);
+            break;
+        }
+        case IMPANEL_UPDATE_PREEDIT_TEXT: {
+            QString text = r.readString();
+            QString attr = r.readString();
+            if (r.ok())
+                emit UpdatePreeditText(text, attr);
+            break;
+        }
+        case IMPANEL_UPDATE_PREEDIT_CARET: {
+            int pos = r.readInt();
+            if (r.ok())
+                emit UpdatePreeditCaret(pos);
+            break;
+        }
+        case IMPANEL_UPDATE_AUX: {
+            QString text = r.readString();
+            QString attr = r.readString();
+            if (r.ok())
+                emit UpdateAux(text, attr);
+            break;
+        }
+        case IMPANEL_UPDATE_LOOKUPTABLE: {
+            QStringList labels = r.readStringList();
+            QStringList candidates = r.readStringList();
+            QStringList attrs = r.readStringList();
+            bool hasPrev = r.readBool();
+            bool hasNext = r.readBool();
+            if (r.ok())
+                emit UpdateLookupTable(labels, candidates, attrs, hasPrev, hasNext);
+            break;
+        }
+        case IMPANEL_UPDATE_LOOKUPTABLE_CURSOR: {
+            int pos = r.readInt();
+            if (r.ok())
+                emit UpdateLookupTableCursor(pos);
+            break;
+        }
+        case IMPANEL_UPDATE_SPOT_LOCATION: {
+            int x = r.readInt();
+            int y = r.readInt();
+            if (r.ok())
+                emit UpdateSpotLocation(x, y);
+            break;
+        }
+        default:
+            /// unknown message from a newer bridge
+            return true;
+    }
+    return r.ok();
+}
@@ -0,0 +1,70 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMPANELSOCKET_H
+#define IMPANELSOCKET_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+/**
+ * Receiving end of the private bridge transport, see impanelproto.h
+ *
+ * Decoded messages are emitted as the same named signals as their
+ * org.kde.kimpanel.inputmethod counterparts.
+ */
+class IMPanelSocket : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IMPanelSocket(QObject* parent = 0);
+    virtual ~IMPanelSocket();
+Q_SIGNALS:
+    void ShowPreedit(bool toshow);
+    void ShowAux(bool toshow);
+    void ShowLookupTable(bool toshow);
+    void UpdatePreeditText(const QString& text, const QString& attr);
+    void UpdatePreeditCaret(int pos);
+    void UpdateAux(const QString& text, const QString& attr);
+    void UpdateLookupTable(const QStringList& labels,
+                           const QStringList& candidates,
+                           const QStringList& attrs,
+                           bool hasPrev,
+                           bool hasNext);
+    void UpdateLookupTableCursor(int pos);
+    void UpdateSpotLocation(int x, int y);
+private Q_SLOTS:
+    void slotNewConnection();
+    void slotReadyRead();
+    void slotDisconnected();
+private:
+    bool dispatch(quint32 type, const QByteArray& payload);
+    QLocalServer* m_server;
+    /// pending bytes of incomplete messages per bridge
+    QHash<QLocalSocket*, QByteArray> m_buffers;
+};
+
+#endif // IMPANELSOCKET_H
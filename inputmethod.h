@@ -26,6 +26,7 @@
 
 #include <KIconLoader>
 
+#include "ibuspanel.h"
 #include "inputmethods.h"
 
 class InputMethodWidget : public QWidget, public Ui::InputMethod
@@ -50,6 +51,7 @@ public:
 
         ok = IBusInputMethod::self()->getVersion(version);
         kcfg_RunIBus->setEnabled(ok);
+        kcfg_IBusInProcessPanel->setEnabled(ok && IBusPanel::self()->isAvailable());
         if (ok) {
             IBusVersionWidget->setText(i18n("Found version: %1", version));
             IBusVersionWidget->setPixmap(MainBarIcon("flag-green"));
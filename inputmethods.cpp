@@ -29,6 +29,7 @@
 #include <KProcess>
 
 #include "envsettings.h"
+#include "ibuspanel.h"
 
 #include "kimtoysettings.h"
 
@@ -149,6 +150,26 @@ void IBusInputMethod::run()
     if (!KIMToySettings::self()->iBusArgs().isEmpty())
         args = KIMToySettings::self()->iBusArgs().split(' ');
 
+    bool inProcessPanel = KIMToySettings::self()->iBusInProcessPanel() && IBusPanel::self()->isAvailable();
+    if (inProcessPanel) {
+        /// the daemon must not spawn its own panel component
+        for (int i = args.count() - 1; i >= 0; --i) {
+            if (args.at(i) == "-p" || args.at(i) == "--panel") {
+                if (i + 1 < args.count())
+                    args.removeAt(i + 1);
+                args.removeAt(i);
+            }
+            else if (args.at(i).startsWith("--panel=")) {
+                args.removeAt(i);
+            }
+        }
+        args << "--panel=disable";
+        /// a running daemon may still own its panel, replace it
+        if (!args.contains("-r"))
+            args << "-r";
+        IBusPanel::self()->start();
+    }
+
     if (isProcessRunning(iBusCmd) && !args.contains("-r")) {
         return;
     }
@@ -160,6 +181,7 @@ void IBusInputMethod::run()
 
 void IBusInputMethod::kill()
 {
+    IBusPanel::self()->stop();
     killProcess(KIMToySettings::self()->iBusCmd());
 }
 
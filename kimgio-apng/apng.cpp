@@ -39,6 +39,9 @@
 #include <qstringlist.h>
 #include <qtextcodec.h>
 
+/// decoded frames kept per handler so that loops do not decode again
+static const qint64 APNG_FRAME_CACHE_SIZE = 8 * 1024 * 1024;
+
 class QAPngHandlerPrivate
 {
 public:
@@ -59,6 +62,18 @@ public:
     int frameCount;
     int playCount;
     int nextDelay;
+    QSize size;
+
+    /// device position of the png signature, -1 before the first parse
+    qint64 startPos;
+    /// frame the libpng state is positioned at
+    int decodeIndex;
+    /// frame index, delays of all frames decoded so far
+    QVector<int> delays;
+    /// frames decoded on the first pass, served on later loops and jumps
+    QVector<QImage> frames;
+    qint64 cachedBytes;
+    bool cacheDropped;
 
     QAPngHandlerPrivate(QAPngHandler* qq);
     ~QAPngHandlerPrivate();
@@ -66,7 +81,12 @@ public:
     bool readAPngHeader();
     QImage::Format readImageFormat();
 
+    bool ensureHeader();
+    bool startDecoder();
+    void stopDecoder();
+    bool decodeFrame(QImage* outImage);
     bool readImage(QImage* outImage);
+    bool jumpToImage(int imageNumber);
 
     bool getNextImage(QImage* result);
     int currentImageNumber() const;
@@ -265,12 +285,14 @@ static void setup_qt(QImage& image, png_structp png_ptr, png_infop info_ptr)
 QAPngHandlerPrivate::QAPngHandlerPrivate(QAPngHandler* qq)
 : q(qq), readDone(false), gamma(0.0),
 png_ptr(0), info_ptr(0), end_info(0), row_pointers(0),
-isAPNG(false), frameIndex(0), frameCount(0), playCount(0), nextDelay(0)
+isAPNG(false), frameIndex(0), frameCount(0), playCount(0), nextDelay(0),
+startPos(-1), decodeIndex(0), cachedBytes(0), cacheDropped(false)
 {
 }
 
 QAPngHandlerPrivate::~QAPngHandlerPrivate()
 {
+    stopDecoder();
 }
 
 bool QAPngHandlerPrivate::readAPngHeader()
@@ -307,6 +329,7 @@ bool QAPngHandlerPrivate::readAPngHeader()
     png_read_info(png_ptr, info_ptr);
 
 #ifndef QT_NO_IMAGE_TEXT
+    description.clear();
     png_textp text_ptr;
     int num_text = 0;
     png_get_text(png_ptr,info_ptr, &text_ptr, &num_text);
@@ -336,6 +359,8 @@ bool QAPngHandlerPrivate::readAPngHeader()
     }
 #endif
 
+    size = QSize(png_get_image_width(png_ptr, info_ptr), png_get_image_height(png_ptr, info_ptr));
+
     isAPNG = png_get_valid(png_ptr, info_ptr, PNG_INFO_acTL);
     if (isAPNG) {
         frameCount = png_get_num_frames(png_ptr, info_ptr);
@@ -351,31 +376,56 @@ bool QAPngHandlerPrivate::readAPngHeader()
     return true;
 }
 
-bool QAPngHandlerPrivate::readImage(QImage* outImage)
+bool QAPngHandlerPrivate::ensureHeader()
 {
-    if (!readDone) {
-        bool ret = readAPngHeader();
-        if (!ret)
-            return false;
+    if (startPos != -1)
+        return true;
+    return startDecoder();
+}
 
-        setup_png(png_ptr, info_ptr, gamma);
+bool QAPngHandlerPrivate::startDecoder()
+{
+    stopDecoder();
 
-        readDone = true;
+    if (startPos == -1) {
+        startPos = q->device()->pos();
+        QVariant cache = q->device()->property(APNG_FRAME_CACHE_PROPERTY);
+        cacheDropped = cache.isValid() && !cache.toBool();
     }
+    else if (!q->device()->seek(startPos))
+        return false;
 
-    if (setjmp(png_jmpbuf(png_ptr))) {
+    if (!readAPngHeader())
+        return false;
+
+    setup_png(png_ptr, info_ptr, gamma);
+
+    readDone = true;
+    decodeIndex = 0;
+    return true;
+}
+
+void QAPngHandlerPrivate::stopDecoder()
+{
+    if (png_ptr)
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-        delete[] row_pointers;
-        png_ptr = 0;
+    png_ptr = 0;
+    delete[] row_pointers;
+    row_pointers = 0;
+    readDone = false;
+}
+
+bool QAPngHandlerPrivate::decodeFrame(QImage* outImage)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        stopDecoder();
         return false;
     }
 
     setup_qt(*outImage, png_ptr, info_ptr);
 
     if (outImage->isNull()) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-        delete [] row_pointers;
-        png_ptr = 0;
+        stopDecoder();
         return false;
     }
 
@@ -401,43 +451,80 @@ bool QAPngHandlerPrivate::readImage(QImage* outImage)
 
         next_frame_delay_num = png_get_next_frame_delay_num(png_ptr, info_ptr);
         next_frame_delay_den = png_get_next_frame_delay_den(png_ptr, info_ptr);
-        nextDelay = next_frame_delay_num * 1000 / next_frame_delay_den;
+        nextDelay = next_frame_delay_num * 1000 / (next_frame_delay_den ? next_frame_delay_den : 100);
+    }
+
+    png_read_image(png_ptr, row_pointers);
 
-        png_read_image(png_ptr, row_pointers);
+    outImage->setDotsPerMeterX(png_get_x_pixels_per_meter(png_ptr, info_ptr));
+    outImage->setDotsPerMeterY(png_get_y_pixels_per_meter(png_ptr, info_ptr));
 
-        outImage->setDotsPerMeterX(png_get_x_pixels_per_meter(png_ptr, info_ptr));
-        outImage->setDotsPerMeterY(png_get_y_pixels_per_meter(png_ptr, info_ptr));
+    delete[] row_pointers;
+    row_pointers = 0;
 
-        frameIndex++;
-        if (frameIndex == frameCount) {
-            frameIndex = 0;
+    if (decodeIndex == delays.count())
+        delays.append(nextDelay);
 
-            png_read_end(png_ptr, info_ptr);
+    /// keep the first pass while it fits, later loops then skip libpng
+    if (isAPNG && frameCount > 1 && !cacheDropped && decodeIndex == frames.count()) {
+        cachedBytes += outImage->byteCount();
+        if (cachedBytes > APNG_FRAME_CACHE_SIZE) {
+            cacheDropped = true;
+            frames.clear();
+        }
+        else {
+            frames.append(*outImage);
+        }
+    }
 
-            png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+    ++decodeIndex;
+    if (decodeIndex == frameCount) {
+        png_read_end(png_ptr, info_ptr);
+        stopDecoder();
+    }
 
-            readDone = false;
+    return true;
+}
 
-            /// rewind
-            q->device()->seek(0);
-        }
+bool QAPngHandlerPrivate::readImage(QImage* outImage)
+{
+    if (frameIndex < frames.count()) {
+        *outImage = frames.at(frameIndex);
+        nextDelay = delays.at(frameIndex);
     }
     else {
-        png_read_image(png_ptr, row_pointers);
+        /// libpng only reads forward, restart for frames behind it
+        if (!readDone || decodeIndex > frameIndex) {
+            if (!startDecoder())
+                return false;
+        }
 
-        outImage->setDotsPerMeterX(png_get_x_pixels_per_meter(png_ptr, info_ptr));
-        outImage->setDotsPerMeterY(png_get_y_pixels_per_meter(png_ptr, info_ptr));
+        while (decodeIndex < frameIndex) {
+            QImage skipped;
+            if (!decodeFrame(&skipped))
+                return false;
+        }
 
-        png_read_end(png_ptr, info_ptr);
+        if (!decodeFrame(outImage))
+            return false;
+    }
 
-        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+    frameIndex++;
+    if (frameIndex == frameCount)
+        frameIndex = 0;
 
-        readDone = false;
-    }
+    return true;
+}
 
-    delete[] row_pointers;
-    row_pointers = 0;
+bool QAPngHandlerPrivate::jumpToImage(int imageNumber)
+{
+    if (!ensureHeader())
+        return false;
+
+    if (imageNumber < 0 || imageNumber >= frameCount)
+        return false;
 
+    frameIndex = imageNumber;
     return true;
 }
 
@@ -500,7 +587,10 @@ int QAPngHandlerPrivate::imageCount() const
 
 int QAPngHandlerPrivate::loopCount() const
 {
-    return playCount;
+    /// apng counts plays with 0 for forever, Qt counts repeats with -1 for forever
+    if (!isAPNG)
+        return 0;
+    return playCount == 0 ? -1 : playCount - 1;
 }
 
 int QAPngHandlerPrivate::nextImageDelay() const
@@ -521,7 +611,8 @@ QAPngHandler::~QAPngHandler()
 bool QAPngHandler::canRead() const
 {
 //     qWarning() << "QAPngHandler::canRead";
-    if (d->readDone && d->frameIndex < d->frameCount)
+    /// animations loop from the frame cache or by restarting the decoder
+    if (d->readDone || (d->isAPNG && d->startPos != -1))
         return true;
     return canRead(device());
 }
@@ -539,6 +630,18 @@ bool QAPngHandler::read(QImage* image)
     return d->readImage(image);
 }
 
+bool QAPngHandler::jumpToImage(int imageNumber)
+{
+    return d->jumpToImage(imageNumber);
+}
+
+bool QAPngHandler::jumpToNextImage()
+{
+    if (!d->ensureHeader() || d->frameCount == 0)
+        return false;
+    return d->jumpToImage((d->frameIndex + 1) % d->frameCount);
+}
+
 int QAPngHandler::currentImageNumber() const
 {
     return d->currentImageNumber();
@@ -572,16 +675,17 @@ bool QAPngHandler::canRead(QIODevice* device)
 QVariant QAPngHandler::option(ImageOption option) const
 {
 //     qWarning() << "option";
-    if (option == Animation)
-        return true;
     if (option == Gamma)
         return d->gamma;
     if (option == Description)
         return d->description;
+    if (!d->ensureHeader())
+        return QVariant();
+    if (option == Animation)
+        return d->isAPNG && d->frameCount > 1;
     if (option == Size)
-        return QSize(png_get_image_width(d->png_ptr, d->info_ptr),
-                     png_get_image_height(d->png_ptr, d->info_ptr));
-    if (option == ImageFormat)
+        return d->size;
+    if (option == ImageFormat && d->png_ptr)
         return d->readImageFormat();
     return QVariant();
 }
@@ -25,6 +25,9 @@
 #include <QImageIOHandler>
 #include <QImageIOPlugin>
 
+/// device property, false keeps the handler from caching decoded frames
+#define APNG_FRAME_CACHE_PROPERTY "_kimtoy_apng_frame_cache"
+
 class QAPngHandlerPrivate;
 class QAPngHandler : public QImageIOHandler
 {
@@ -34,6 +37,8 @@ public:
     virtual bool canRead() const;
     virtual QByteArray name() const;
     virtual bool read(QImage* image);
+    virtual bool jumpToImage(int imageNumber);
+    virtual bool jumpToNextImage();
     virtual int currentImageNumber() const;
     virtual int imageCount() const;
     virtual int loopCount() const;
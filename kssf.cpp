@@ -21,29 +21,39 @@
 
 #include "kssf.h"
 
+#include <QBuffer>
 #include <QByteArray>
 #include <QDataStream>
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <string.h>
 
 // ase decrypt
 #include <openssl/aes.h>
 
+// inflate
+#include <zlib.h>
+
 #include <KArchive>
 #include <KZip>
 
+#include "themecache.h"
+
 KSsf::KSsf(const QString& filename)
         : KZip(filename)
 {
     isZip = true;
-    tmpFile = 0;
+    plainDevice = 0;
 }
 
 KSsf::KSsf(QIODevice* dev)
         : KZip(dev)
 {
     isZip = true;
-    tmpFile = 0;
+    plainDevice = 0;
 }
 
 KSsf::~KSsf()
@@ -51,7 +61,7 @@ KSsf::~KSsf()
     if(isOpen())
         close();
 
-    delete tmpFile;
+    delete plainDevice;
 }
 
 bool KSsf::doWriteSymLink(const QString &name, const QString &target,
@@ -103,26 +113,14 @@ bool KSsf::doFinishWriting(qint64 size)
     return false;
 }
 
-bool KSsf::openArchive(QIODevice::OpenMode mode)
-{
-    if (mode != QIODevice::ReadOnly) {
-        qWarning() << "Unsupported mode " << mode;
-        return false;
-    }
-
-    QIODevice* dev = device();
-    if (!dev)
-        return false;
-
-    QByteArray magic = dev->read(8);
-    if (magic == QByteArray::fromHex("536B696E03000000")) {
-        qWarning() << "detected encrypted ssf archive";
-        isZip = false;
-    }
+/// ciphertext read per step, a multiple of AES_BLOCK_SIZE
+static const int SSF_CHUNK_SIZE = 64 * 1024;
 
-    if (isZip)
-        return KZip::openArchive(mode);
+/// refuse headers claiming more than this
+static const quint32 SSF_MAX_PLAINLEN = 256 * 1024 * 1024;
 
+static bool decryptArchive(QIODevice* dev, QByteArray& plaindata)
+{
     // decrypt aes-cbc
     AES_KEY dec_key;
 
@@ -142,43 +140,114 @@ bool KSsf::openArchive(QIODevice::OpenMode mode)
         0x8A,0x51,0xFD,0x05,0xDF,0x8C,0x5D,0x0F
     };
 
-    QByteArray encdata = dev->readAll();
-    QByteArray decdata = encdata;
-    AES_cbc_encrypt((const unsigned char*)encdata.constData(), (unsigned char*)decdata.data(), encdata.size(), &dec_key, iv, AES_DECRYPT);
-
-    qWarning() << "decrypt success";
+    // the decrypted stream is a little endian plain length and a zlib stream
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+        return false;
 
-    // convert header byte order
-    QDataStream dds(&decdata, QIODevice::ReadWrite);
-    dds.setByteOrder(QDataStream::LittleEndian);
-    quint32 plainlen;
-    dds >> plainlen;
-    dds.device()->reset();
-    dds.setByteOrder(QDataStream::BigEndian);
-    dds << plainlen;
+    QByteArray chunk(SSF_CHUNK_SIZE, Qt::Uninitialized);
+    bool haveHeader = false;
+    int ret = Z_OK;
+
+    while (ret != Z_STREAM_END) {
+        // fill whole chunks so that only the last one can end mid block
+        qint64 len = 0;
+        while (len < SSF_CHUNK_SIZE) {
+            qint64 n = dev->read(chunk.data() + len, SSF_CHUNK_SIZE - len);
+            if (n <= 0)
+                break;
+            len += n;
+        }
+        if (len == 0)
+            break;
+
+        // the cbc chain carries over between chunks in iv
+        AES_cbc_encrypt((const unsigned char*)chunk.constData(), (unsigned char*)chunk.data(), len, &dec_key, iv, AES_DECRYPT);
+
+        const uchar* in = (const uchar*)chunk.constData();
+        if (!haveHeader) {
+            if (len < 4)
+                break;
+            quint32 plainlen = qFromLittleEndian<quint32>(in);
+            if (plainlen == 0 || plainlen > SSF_MAX_PLAINLEN)
+                break;
+            plaindata = QByteArray(plainlen, Qt::Uninitialized);
+            zs.next_out = (Bytef*)plaindata.data();
+            zs.avail_out = plainlen;
+            in += 4;
+            len -= 4;
+            haveHeader = true;
+        }
+
+        zs.next_in = (Bytef*)in;
+        zs.avail_in = len;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            break;
+    }
 
-    // zlib uncompress
-    QByteArray plaindata = qUncompress(decdata);
+    inflateEnd(&zs);
 
-    if (plaindata.isEmpty()) {
+    if (ret != Z_STREAM_END) {
         qWarning() << "uncompress failed";
+        plaindata.clear();
         return false;
     }
 
+    plaindata.resize(zs.total_out);
+
     qWarning() << "uncompress success";
 
-    // create plain temp file
-    tmpFile = new QTemporaryFile();
-    tmpFile->open();
+    return true;
+}
+
+bool KSsf::openArchive(QIODevice::OpenMode mode)
+{
+    if (mode != QIODevice::ReadOnly) {
+        qWarning() << "Unsupported mode " << mode;
+        return false;
+    }
+
+    QIODevice* dev = device();
+    if (!dev)
+        return false;
 
-    tmpFile->write(plaindata);
+    QByteArray magic = dev->read(8);
+    if (magic == QByteArray::fromHex("536B696E03000000")) {
+        qWarning() << "detected encrypted ssf archive";
+        isZip = false;
+    }
+
+    if (isZip)
+        return KZip::openArchive(mode);
+
+    // decoded archives of theme files are cached on disk
+    QFileInfo info(fileName());
+    QIODevice* plain = fileName().isEmpty() ? 0 : ThemeCache::open(info);
+
+    if (!plain) {
+        QByteArray plaindata;
+        if (!decryptArchive(dev, plaindata))
+            return false;
+
+        if (!fileName().isEmpty())
+            ThemeCache::store(info, plaindata);
+
+        // serve entries from memory
+        QBuffer* buffer = new QBuffer;
+        buffer->setData(plaindata);
+        buffer->open(QIODevice::ReadOnly);
+        plain = buffer;
+    }
 
-    qWarning() << "creating tempfile:" << tmpFile->fileName();
+    delete plainDevice;
+    plainDevice = plain;
 
-    setDevice(tmpFile);
+    setDevice(plainDevice);
 
     // read offset table
-    QDataStream ds(plaindata);
+    QDataStream ds(plainDevice);
     ds.setByteOrder(QDataStream::LittleEndian);
 
     quint32 size;
@@ -232,7 +301,7 @@ bool KSsf::closeArchive()
     if (isZip)
         return KZip::closeArchive();
 
-    tmpFile->close();
+    plainDevice->close();
 
     return true;
 }
@@ -22,7 +22,7 @@
 #ifndef KSSF_H
 #define KSSF_H
 
-#include <QTemporaryFile>
+#include <QIODevice>
 #include <KArchive>
 #include <KZip>
 
@@ -60,7 +60,8 @@ protected:
     virtual void virtual_hook(int id, void* data);
 private:
     bool isZip;
-    QTemporaryFile* tmpFile;
+    /// decrypted archive in memory or mapped from the cache, entries are served from here
+    QIODevice* plainDevice;
 };
 
 #endif // KSSF_H
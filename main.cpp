@@ -27,6 +27,7 @@
 #include <KLocalizedString>
 
 #include "kimtoy.h"
+#include "themecache.h"
 
 int main(int argc, char** argv)
 {
@@ -58,6 +59,9 @@ int main(int argc, char** argv)
     parser.process(app);
     aboutData.processCommandLine(&parser);
 
+    /// thumbnailers and extractors only read what kimtoy decoded
+    ThemeCache::setStoreEnabled(true);
+
     app.newInstance();
 
     return app.exec();
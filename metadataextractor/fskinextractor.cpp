@@ -23,12 +23,15 @@
 
 #include <QByteArray>
 #include <QFile>
+#include <QScopedPointer>
 #include <QString>
 #include <QStringList>
 #include <QTextStream>
 
 #include <KTar>
 
+#include "../themecache.h"
+
 FskinExtractor::FskinExtractor(QObject* parent)
         : KFileMetaData::ExtractorPlugin(parent)
 {
@@ -47,7 +50,11 @@ void FskinExtractor::extract(KFileMetaData::ExtractionResult* result)
     if (!QFile::exists(file))
         return;
 
-    KTar tar(file);
+    QScopedPointer<QIODevice> dev(ThemeCache::openTar(file));
+    if (!dev)
+        return;
+
+    KTar tar(dev.data());
     if (!tar.open(QIODevice::ReadOnly))
         return;
 
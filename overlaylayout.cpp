@@ -0,0 +1,147 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "overlaylayout.h"
+
+void OverlayLayout::expandSurrounding(const OverlayAlign& align, const QSize& pixmapSize,
+                                      int& opt, int& opb, int& opl, int& opr)
+{
+    switch (align.alignArea) {
+        case 1:
+            opl = qMax(opl, pixmapSize.width());
+            opt = qMax(opt, pixmapSize.height());
+            break;
+        case 2:
+            opt = qMax(opt, pixmapSize.height());
+            break;
+        case 3:
+            opr = qMax(opr, pixmapSize.width());
+            opt = qMax(opt, pixmapSize.height());
+            break;
+        case 4:
+            opl = qMax(opl, pixmapSize.width());
+            break;
+        case 5:
+            /// center pixmap, no addition
+            break;
+        case 6:
+            opr = qMax(opr, pixmapSize.width());
+            break;
+        case 7:
+            opl = qMax(opl, pixmapSize.width());
+            opb = qMax(opb, pixmapSize.height());
+            break;
+        case 8:
+            opb = qMax(opb, pixmapSize.height());
+            break;
+        case 9:
+            opr = qMax(opr, pixmapSize.width());
+            opb = qMax(opb, pixmapSize.height());
+            break;
+        default:
+            /// never arrive here
+            break;
+    }
+}
+
+QRect OverlayLayout::place(const OverlayAlign& align, const QSize& pixmapSize, const QSize& size,
+                           int opt, int opb, int opl, int opr)
+{
+    const int pw = pixmapSize.width();
+    const int ph = pixmapSize.height();
+    const int width = size.width();
+    const int height = size.height();
+
+    /// horizontal position of t, center and b areas
+    int hx = 0;
+    if (align.alignHMode == 0)
+        hx = (width + opl - opr - pw) / 2 + align.ml / 2;
+    else if (align.alignHMode == 1)
+        hx = opl + align.ml;
+    else if (align.alignHMode == 2)
+        hx = width - opr - pw - align.mr;
+
+    /// vertical position of l, center and r areas
+    int vy = 0;
+    if (align.alignVMode == 0)
+        vy = (height - opb + opt - ph) / 2 + align.mt / 2;
+    else if (align.alignVMode == 1)
+        vy = opt + align.mt;
+    else if (align.alignVMode == 2)
+        vy = height - opb - ph - align.mb;
+
+    const bool hvalid = align.alignHMode >= 0 && align.alignHMode <= 2;
+    const bool vvalid = align.alignVMode >= 0 && align.alignVMode <= 2;
+
+    int x = 0;
+    int y = 0;
+    switch (align.alignArea) {
+        case 1:
+            x = align.ml;
+            y = align.mt;
+            break;
+        case 2:
+            if (hvalid) {
+                x = hx;
+                y = align.mt;
+            }
+            break;
+        case 3:
+            x = width - opr - align.mr;
+            y = align.mt;
+            break;
+        case 4:
+            if (vvalid) {
+                x = align.ml;
+                y = vy;
+            }
+            break;
+        case 5:
+            x = hx;
+            y = vy;
+            break;
+        case 6:
+            if (vvalid) {
+                x = width - opr - align.mr;
+                y = vy;
+            }
+            break;
+        case 7:
+            x = align.ml;
+            y = height - opb - align.mb;
+            break;
+        case 8:
+            if (hvalid) {
+                x = hx;
+                y = height - opb - align.mb;
+            }
+            break;
+        case 9:
+            x = width - opr - align.mr;
+            y = height - opb - align.mb;
+            break;
+        default:
+            /// never arrive here
+            break;
+    }
+
+    return QRect(QPoint(x, y), pixmapSize);
+}
@@ -0,0 +1,61 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OVERLAYLAYOUT_H
+#define OVERLAYLAYOUT_H
+
+#include <QRect>
+#include <QSize>
+
+class OverlayAlign
+{
+public:
+    /**
+     * overlay layout
+     *
+     *  lt|                t              |rt
+     * ---+===============================+---
+     *    |      ##### preedit #####      |
+     *   l|-------------center------------|r
+     *    |      #### candidate ####      |
+     * ---+===============================+---
+     *  lb|                b              |rb
+     *
+     */
+    /// TODO: only entire window is supported atm --- nihui
+    int alignTarget;// 0->entire window, 1->preedit window, 2->candidate window
+    int alignArea;// 1->lt, 2->t, 3->rt, 4->l, 5->center, 6->r, 7->lb, 8->b, 9->rb
+    int alignHMode;// 0->align center, 1->align left, 2->align right
+    int alignVMode;// 0->align center, 1->align top, 2->align bottom
+    int mt, mb, ml, mr;// margins
+};
+
+namespace OverlayLayout
+{
+/// grow the overlay surrounding opt/opb/opl/opr to hold an overlay of pixmapSize
+void expandSurrounding(const OverlayAlign& align, const QSize& pixmapSize,
+                       int& opt, int& opb, int& opl, int& opr);
+/// rectangle of an overlay of pixmapSize in a window of size
+QRect place(const OverlayAlign& align, const QSize& pixmapSize, const QSize& size,
+            int opt, int opb, int opl, int opr);
+}
+
+#endif // OVERLAYLAYOUT_H
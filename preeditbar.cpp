@@ -22,23 +22,27 @@
 #include "preeditbar.h"
 
 #include <QApplication>
-#include <QDBusConnection>
 #include <QDebug>
-#include <QDesktopWidget>
+#include <QGuiApplication>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <QPainter>
 #include <QResizeEvent>
+#include <QScreen>
 #include <QSizePolicy>
 #include <QVBoxLayout>
 
 #include <KWindowSystem>
 
+#include "impanelagent.h"
+#include "impanelrelay.h"
 #include "themeragent.h"
 
 #include "kimtoysettings.h"
 
 #include <QX11Info>
 #include <X11/Xlib.h>
+#include <X11/extensions/shape.h>
 
 PreEditBar::PreEditBar()
 {
@@ -56,32 +60,46 @@ PreEditBar::PreEditBar()
 
     spotX = 0;
     spotY = 0;
+    spotHeight = 0;
 
     preeditVisible = false;
     auxVisible = false;
     lookuptableVisible = false;
 
-    QDBusConnection connection = QDBusConnection::sessionBus();
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateSpotLocation",
-                       this, SLOT(slotUpdateSpotLocation(int,int)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowPreedit",
-                       this, SLOT(slotShowPreedit(bool)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowAux",
-                       this, SLOT(slotShowAux(bool)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ShowLookupTable",
-                       this, SLOT(slotShowLookupTable(bool)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdatePreeditCaret",
-                       this, SLOT(slotUpdatePreeditCaret(int)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdatePreeditText",
-                       this, SLOT(slotUpdatePreeditText(QString,QString)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateAux",
-                       this, SLOT(slotUpdateAux(QString,QString)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateLookupTableCursor",
-                       this, SLOT(slotUpdateLookupTableCursor(int)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateLookupTable",
-                       this, SLOT(slotUpdateLookupTable(QStringList,QStringList,QStringList,bool,bool)));
-
-    updateSize();
+    m_cursorPos = 0;
+    m_candidateCursor = 0;
+    m_revision = 0;
+
+    m_commitTimer.setSingleShot(true);
+    connect(&m_commitTimer, SIGNAL(timeout()), this, SLOT(slotCommit()));
+
+    /// kimpanel signals from the bus, the bridge socket and the in-process ibus panel
+    IMPanelRelay* relay = IMPanelRelay::self();
+    connect(relay, SIGNAL(UpdateSpotLocation(int,int)), this, SLOT(slotUpdateSpotLocation(int,int)));
+    connect(relay, SIGNAL(ShowPreedit(bool)), this, SLOT(slotShowPreedit(bool)));
+    connect(relay, SIGNAL(ShowAux(bool)), this, SLOT(slotShowAux(bool)));
+    connect(relay, SIGNAL(ShowLookupTable(bool)), this, SLOT(slotShowLookupTable(bool)));
+    connect(relay, SIGNAL(UpdatePreeditCaret(int)), this, SLOT(slotUpdatePreeditCaret(int)));
+    connect(relay, SIGNAL(UpdatePreeditText(QString,QString)), this, SLOT(slotUpdatePreeditText(QString,QString)));
+    connect(relay, SIGNAL(UpdateAux(QString,QString)), this, SLOT(slotUpdateAux(QString,QString)));
+    connect(relay, SIGNAL(UpdateLookupTableCursor(int)), this, SLOT(slotUpdateLookupTableCursor(int)));
+    connect(relay, SIGNAL(UpdateLookupTable(QStringList,QStringList,QStringList,bool,bool)),
+            this, SLOT(slotUpdateLookupTable(QStringList,QStringList,QStringList,bool,bool)));
+
+    /// kimpanel v2
+    connect(IMPanelAgent::panel(), SIGNAL(spotRectChanged(int,int,int,int)),
+            this, SLOT(slotSetSpotRect(int,int,int,int)));
+    connect(IMPanelAgent::panel(), SIGNAL(lookupTableChanged(QStringList,QStringList,QStringList,bool,bool,int)),
+            this, SLOT(slotSetLookupTable(QStringList,QStringList,QStringList,bool,bool,int)));
+
+    /// screen layout cache
+    connect(qApp, SIGNAL(screenAdded(QScreen*)), this, SLOT(slotScreenAdded(QScreen*)));
+    foreach (QScreen* screen, QGuiApplication::screens()) {
+        slotScreenAdded(screen);
+    }
+
+    m_shapedOut = false;
+    updatePlacement();
 }
 
 PreEditBar::~PreEditBar()
@@ -114,7 +132,15 @@ void PreEditBar::resizeEvent(QResizeEvent* event)
     if (KIMToySettings::self()->enableWindowMask()) {
         ThemerAgent::maskPreEditBar(this);
     }
-    slotUpdateSpotLocation(spotX, spotY);
+    if (m_shapedOut) {
+        /// the theme mask just replaced the empty shape
+        applyShapedOut();
+    }
+    /// no-op when the resize came from updatePlacement
+    QPoint placedPos = placedRect(event->size()).topLeft();
+    if (placedPos != pos()) {
+        move(placedPos);
+    }
     if (KIMToySettings::self()->enableBackgroundBlur()) {
         ThemerAgent::blurPreEditBar(this);
     }
@@ -124,13 +150,17 @@ void PreEditBar::showEvent(QShowEvent* event)
 {
 //     Plasma::WindowEffects::overrideShadow(winId(), true);
     Display* dpy = QX11Info::display();
-    Atom atom = XInternAtom(dpy, "_KDE_NET_WM_SHADOW", False);
+    static Atom atom = XInternAtom(dpy, "_KDE_NET_WM_SHADOW", False);
     XDeleteProperty(dpy, winId(), atom);
 }
 
 void PreEditBar::paintEvent(QPaintEvent* event)
 {
-    Q_UNUSED(event);
+    /// nothing is shown, setShapedOut(false) repaints everything
+    if (m_shapedOut)
+        return;
+
+    m_paintRect = event->rect();
     ThemerAgent::drawPreEditBar(this);
 }
 
@@ -138,57 +168,111 @@ void PreEditBar::slotUpdateSpotLocation(int x, int y)
 {
     spotX = x;
     spotY = y;
+    spotHeight = 0;
+    scheduleCommit();
+}
+
+void PreEditBar::slotSetSpotRect(int x, int y, int w, int h)
+{
+    Q_UNUSED(w)
+    /// anchor at the bottom left of the input context
+    spotX = x;
+    spotY = y + h;
+    spotHeight = h;
+    scheduleCommit();
+}
+
+void PreEditBar::slotScreenAdded(QScreen* screen)
+{
+    connect(screen, SIGNAL(geometryChanged(QRect)), this, SLOT(slotInvalidateScreens()));
+    connect(screen, SIGNAL(destroyed()), this, SLOT(slotInvalidateScreens()));
+    m_screenRects.clear();
+}
+
+void PreEditBar::slotInvalidateScreens()
+{
+    m_screenRects.clear();
+}
+
+QRect PreEditBar::screenRectAt(const QPoint& pos) const
+{
+    if (m_screenRects.isEmpty()) {
+        foreach (QScreen* screen, QGuiApplication::screens()) {
+            m_screenRects.append(screen->geometry());
+        }
+    }
+
+    foreach (const QRect& rect, m_screenRects) {
+        if (rect.contains(pos))
+            return rect;
+    }
+
+    /// the first one is the primary screen
+    return m_screenRects.isEmpty() ? QRect() : m_screenRects.first();
+}
+
+QRect PreEditBar::placedRect(const QSize& size) const
+{
+    int x = spotX;
+    int y = spotY;
 
     // impanel report device pos, so convert to logical pos
     qreal dpr = devicePixelRatioF();
     x /= dpr;
     y /= dpr;
 
-    QRect screenRect = QApplication::desktop()->screenGeometry(QPoint(x, y));
-    x = qMin(x, screenRect.x() + screenRect.width() - width());
+    QRect screenRect = screenRectAt(QPoint(x, y));
+    x = qMin(x, screenRect.x() + screenRect.width() - size.width());
     y = qMin(y, screenRect.y() + screenRect.height());
 
     QPoint anchorPos = ThemerAgent::anchorPos();
     x -= anchorPos.x();
     y -= anchorPos.y();
 
-    if (y + height() > screenRect.y() + screenRect.height()) {
-        /// minus 20 to make preedit bar never overlap the input context
-        y -= height() - anchorPos.y() + 20;
+    if (y + size.height() > screenRect.y() + screenRect.height()) {
+        /// flip above the input context, guess its height as 20 if unknown
+        int contextHeight = spotHeight > 0 ? spotHeight / dpr : 20;
+        y -= size.height() - anchorPos.y() + contextHeight;
     }
-    if (QPoint(x, y) != pos()) {
-        move(x, y);
+    return QRect(QPoint(x, y), size);
+}
+
+void PreEditBar::updatePlacement()
+{
+    /// size and position go out as one configure request
+    QRect rect = placedRect(ThemerAgent::sizeHintPreEditBar(this));
+    if (rect != geometry()) {
+        setGeometry(rect);
     }
 }
 
 void PreEditBar::slotShowPreedit(bool show)
 {
     preeditVisible = show;
-    updateVisible();
-    updateSize();
-    update();
+    scheduleCommit();
 }
 
 void PreEditBar::slotShowAux(bool show)
 {
     auxVisible = show;
-    updateVisible();
-    updateSize();
-    update();
+    scheduleCommit();
 }
 
 void PreEditBar::slotShowLookupTable(bool show)
 {
     lookuptableVisible = show;
-    updateVisible();
-    updateSize();
-    update();
+    scheduleCommit();
 }
 
 void PreEditBar::slotUpdatePreeditCaret(int pos)
 {
+    if (pos == m_cursorPos)
+        return;
+
+    /// repaint the old and new caret only
+    update(ThemerAgent::preEditCaretRect(this));
     m_cursorPos = pos;
-    update();
+    update(ThemerAgent::preEditCaretRect(this));
 }
 
 void PreEditBar::slotUpdatePreeditText(const QString& text,
@@ -196,8 +280,8 @@ void PreEditBar::slotUpdatePreeditText(const QString& text,
 {
     Q_UNUSED(attrs)
     m_text = text;
-    updateSize();
-    update();
+    ++m_revision;
+    scheduleCommit();
 }
 
 void PreEditBar::slotUpdateAux(const QString& text,
@@ -205,14 +289,19 @@ void PreEditBar::slotUpdateAux(const QString& text,
 {
     Q_UNUSED(attrs)
     m_auxText = text;
-    updateSize();
-    update();
+    ++m_revision;
+    scheduleCommit();
 }
 
 void PreEditBar::slotUpdateLookupTableCursor(int pos)
 {
+    if (pos == m_candidateCursor)
+        return;
+
+    /// repaint the old and new candidate cell only
+    update(ThemerAgent::candidateRect(this, m_candidateCursor));
     m_candidateCursor = pos;
-    update();
+    update(ThemerAgent::candidateRect(this, m_candidateCursor));
 }
 
 void PreEditBar::slotUpdateLookupTable(const QStringList& labels,
@@ -226,19 +315,148 @@ void PreEditBar::slotUpdateLookupTable(const QStringList& labels,
     m_candidates = candidates;
     m_hasPrev = hasPrev;
     m_hasNext = hasNext;
-    updateSize();
+    ++m_revision;
+    scheduleCommit();
+}
+
+void PreEditBar::slotSetLookupTable(const QStringList& labels,
+                                    const QStringList& candidates,
+                                    const QStringList& attrs,
+                                    bool hasPrev,
+                                    bool hasNext,
+                                    int cursor)
+{
+    Q_UNUSED(attrs)
+    m_labels = labels;
+    m_candidates = candidates;
+    m_hasPrev = hasPrev;
+    m_hasNext = hasNext;
+    m_candidateCursor = cursor;
+    ++m_revision;
+    scheduleCommit();
+}
+
+void PreEditBar::slotAnimate(const QRect& rect)
+{
+    if (m_shapedOut)
+        return;
+
+    if (rect.isNull())
+        update();
+    else
+        update(rect);
+}
+
+void PreEditBar::slotCommit()
+{
+    m_lastCommit.start();
+    /// place before mapping so a newly shown bar does not jump
+    updatePlacement();
+    updateVisible();
     update();
 }
 
+void PreEditBar::scheduleCommit()
+{
+    if (m_commitTimer.isActive())
+        return;
+
+    int interval = 0;
+    if (m_lastCommit.isValid()) {
+        /// key repeat floods commit at most once per display refresh
+        QScreen* screen = QGuiApplication::primaryScreen();
+        qreal refreshRate = screen ? screen->refreshRate() : 60;
+        int frameInterval = qRound(1000 / qMax(refreshRate, (qreal)1));
+        interval = qMax(frameInterval - (int)m_lastCommit.elapsed(), 0);
+    }
+    m_commitTimer.start(interval);
+}
+
 void PreEditBar::updateVisible()
 {
     bool visible = preeditVisible || auxVisible || lookuptableVisible;
+
+    if (KIMToySettings::self()->keepPreEditBarMapped()) {
+        /// stay mapped, hide by shaping the window out
+        if (!isVisible()) {
+            setShapedOut(!visible);
+            setVisible(true);
+        }
+        else if (m_shapedOut == visible) {
+            setShapedOut(!visible);
+        }
+        return;
+    }
+
+    if (m_shapedOut) {
+        setShapedOut(false);
+    }
     if (isVisible() != visible) {
         setVisible(visible);
     }
 }
 
-void PreEditBar::updateSize()
+void PreEditBar::prewarm()
+{
+    if (!KIMToySettings::self()->keepPreEditBarMapped()) {
+        /// unmap again if the mode was just turned off
+        updateVisible();
+        return;
+    }
+
+    /// paint one frame offscreen so fonts and theme pixmaps are loaded
+    bool shapedOut = m_shapedOut;
+    m_shapedOut = false;
+    grab();
+    m_shapedOut = shapedOut;
+
+    if (!isVisible()) {
+        updatePlacement();
+        setShapedOut(true);
+        setVisible(true);
+    }
+    else if (m_shapedOut) {
+        /// a new theme mask replaced the empty shape
+        applyShapedOut();
+    }
+}
+
+void PreEditBar::setShapedOut(bool shapedOut)
+{
+    m_shapedOut = shapedOut;
+    if (m_shapedOut) {
+        applyShapedOut();
+        return;
+    }
+
+    /// frames were skipped while shaped out
+    update();
+
+    Display* dpy = QX11Info::display();
+    XShapeCombineMask(dpy, winId(), ShapeInput, 0, 0, None, ShapeSet);
+    QRegion region = mask();
+    if (region.isEmpty()) {
+        XShapeCombineMask(dpy, winId(), ShapeBounding, 0, 0, None, ShapeSet);
+        return;
+    }
+
+    /// restore the theme mask, QWidget would skip setting an unchanged one
+    QVector<QRect> rects = region.rects();
+    QVector<XRectangle> xrects(rects.size());
+    for (int i = 0; i < rects.size(); ++i) {
+        xrects[i].x = rects.at(i).x();
+        xrects[i].y = rects.at(i).y();
+        xrects[i].width = rects.at(i).width();
+        xrects[i].height = rects.at(i).height();
+    }
+    XShapeCombineRectangles(dpy, winId(), ShapeBounding, 0, 0, xrects.data(), xrects.size(), ShapeSet, YXBanded);
+}
+
+void PreEditBar::applyShapedOut()
 {
-    resize(ThemerAgent::sizeHintPreEditBar(this));
+    /// zero-area bounding and input shape, still mapped for the compositor
+    Display* dpy = QX11Info::display();
+    XShapeCombineRectangles(dpy, winId(), ShapeBounding, 0, 0, 0, 0, ShapeSet, YXBanded);
+    XShapeCombineRectangles(dpy, winId(), ShapeInput, 0, 0, 0, 0, ShapeSet, YXBanded);
 }
+
@@ -22,9 +22,13 @@
 #ifndef PREEDITBAR_H
 #define PREEDITBAR_H
 
+#include <QElapsedTimer>
+#include <QList>
+#include <QTimer>
 #include <QWidget>
 
-// class Themer;
+class QScreen;
+class Themer;
 class ThemerFcitx;
 class ThemerNone;
 class ThemerPlasma;
@@ -36,6 +40,8 @@ class PreEditBar : public QWidget
 public:
     explicit PreEditBar();
     virtual ~PreEditBar();
+    /// map the window once for the keep mapped mode, after a theme is loaded
+    void prewarm();
 protected:
     virtual bool eventFilter(QObject* object, QEvent* event);
     virtual void resizeEvent(QResizeEvent* event);
@@ -43,6 +49,7 @@ protected:
     virtual void paintEvent(QPaintEvent* event);
 private Q_SLOTS:
     void slotUpdateSpotLocation(int x, int y);
+    void slotSetSpotRect(int x, int y, int w, int h);
     void slotShowPreedit(bool show);
     void slotShowAux(bool show);
     void slotShowLookupTable(bool show);
@@ -57,21 +64,54 @@ private Q_SLOTS:
                                const QStringList& attrs,
                                bool hasPrev,
                                bool hasNext);
+    void slotSetLookupTable(const QStringList& labels,
+                            const QStringList& candidates,
+                            const QStringList& attrs,
+                            bool hasPrev,
+                            bool hasNext,
+                            int cursor);
+    void slotAnimate(const QRect& rect);
+    void slotCommit();
+    void slotScreenAdded(QScreen* screen);
+    void slotInvalidateScreens();
 private:
+    void scheduleCommit();
     void updateVisible();
-    void updateSize();
+    void setShapedOut(bool shapedOut);
+    void applyShapedOut();
+    QRect screenRectAt(const QPoint& pos) const;
+    /// window rectangle of the given size anchored at the spot
+    QRect placedRect(const QSize& size) const;
+    void updatePlacement();
 private:
     QPoint m_pointPos;
     bool m_moving;
 
     int spotX;
     int spotY;
+    /// height of the input context, 0 if the input method does not tell
+    int spotHeight;
 
     bool preeditVisible;
     bool auxVisible;
     bool lookuptableVisible;
 
-//         friend class Themer;
+    /// bounding rectangle of the area being painted
+    QRect m_paintRect;
+    /// bumped whenever the measured content changes
+    int m_revision;
+
+    /// kimpanel signals only record state, one commit per frame applies it
+    QTimer m_commitTimer;
+    QElapsedTimer m_lastCommit;
+
+    /// mapped but with an empty shape instead of unmapped
+    bool m_shapedOut;
+
+    /// screen geometries, refilled after any screen change
+    mutable QList<QRect> m_screenRects;
+
+    friend class Themer;
     friend class ThemerFcitx;
     friend class ThemerNone;
     friend class ThemerPlasma;
@@ -0,0 +1,118 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "preeditlayout.h"
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QTransform>
+
+static QStaticText prepareStaticText(const QString& text, const QFont& font)
+{
+    QStaticText staticText(text);
+    staticText.setTextFormat(Qt::PlainText);
+    staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+    staticText.prepare(QTransform(), font);
+    return staticText;
+}
+
+PreEditLayout::PreEditLayout()
+{
+    vertical = false;
+    preEditWidth = 0;
+    rowHeight = 0;
+    labelOffset = 0;
+    candidateOffset = 0;
+}
+
+void PreEditLayout::layout(const QString& preEditText, const QStringList& labels, const QStringList& candidates,
+                           const QFont& preEditFont, const QFont& labelFont, const QFont& candidateFont,
+                           bool vertical)
+{
+    QFontMetrics preEditMetrics(preEditFont);
+    QFontMetrics labelMetrics(labelFont);
+    QFontMetrics candidateMetrics(candidateFont);
+
+    this->vertical = vertical;
+    this->preEditText = preEditText;
+    preEditWidth = preEditMetrics.width(preEditText);
+    preEditStaticText = prepareStaticText(preEditText, preEditFont);
+    rowHeight = qMax(labelMetrics.height(), candidateMetrics.height());
+    /// same vertical centering as Qt::AlignCenter
+    labelOffset = (rowHeight - labelMetrics.height()) / 2;
+    candidateOffset = (rowHeight - candidateMetrics.height()) / 2;
+
+    int count = qMin(labels.count(), candidates.count());
+    this->labels.clear();
+    this->candidates.clear();
+    labelRects.resize(count);
+    candidateRects.resize(count);
+    labelStaticTexts.resize(count);
+    candidateStaticTexts.resize(count);
+
+    int x = 0;
+    int y = 0;
+    for (int i = 0; i < count; ++i) {
+        QString label = labels.at(i).trimmed();
+        QString candidate = candidates.at(i).trimmed();
+        if (!vertical)
+            candidate += ' ';
+
+        if (vertical)
+            x = 0;
+        int lw = labelMetrics.width(label);
+        labelRects[ i ] = QRect(x, y, lw, rowHeight);
+        x += lw;
+        int cw = candidateMetrics.width(candidate);
+        candidateRects[ i ] = QRect(x, y, cw, rowHeight);
+        x += cw;
+        if (vertical)
+            y += rowHeight;
+
+        this->labels.append(label);
+        this->candidates.append(candidate);
+        labelStaticTexts[ i ] = prepareStaticText(label, labelFont);
+        candidateStaticTexts[ i ] = prepareStaticText(candidate, candidateFont);
+    }
+}
+
+QSize PreEditLayout::lookupTableSize() const
+{
+    if (!vertical) {
+        /// one row, reserved even without candidates
+        int w = candidateRects.isEmpty() ? 0 : candidateRects.last().right() + 1;
+        return QSize(w, rowHeight);
+    }
+
+    int w = 0;
+    for (int i = 0; i < candidateRects.count(); ++i) {
+        w = qMax(candidateRects.at(i).right() + 1, w);
+    }
+    return QSize(w, rowHeight * candidateRects.count());
+}
+
+QRect PreEditLayout::cellRect(int index) const
+{
+    if (index < 0 || index >= labelRects.count())
+        return QRect();
+
+    return labelRects.at(index) | candidateRects.at(index);
+}
@@ -0,0 +1,74 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREEDITLAYOUT_H
+#define PREEDITLAYOUT_H
+
+#include <QRect>
+#include <QSize>
+#include <QStaticText>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFont;
+
+/**
+ * Measured preedit text and lookup table.
+ *
+ * Computed once whenever the preedit bar content changes and shared by
+ * size hint, painting and partial repaints. Cell rectangles are relative
+ * to the lookup table origin of the themer. All strings are kept as
+ * prepared static texts, so repaints only draw the shaped glyphs.
+ */
+class PreEditLayout
+{
+public:
+    explicit PreEditLayout();
+    void layout(const QString& preEditText, const QStringList& labels, const QStringList& candidates,
+                const QFont& preEditFont, const QFont& labelFont, const QFont& candidateFont,
+                bool vertical);
+    int count() const {
+        return labels.count();
+    }
+    QSize lookupTableSize() const;
+    /// label and candidate at index, empty if out of range
+    QRect cellRect(int index) const;
+
+    bool vertical;
+    QString preEditText;
+    int preEditWidth;
+    int rowHeight;
+    /// trimmed, horizontal candidates keep one trailing space as separator
+    QStringList labels;
+    QStringList candidates;
+    QVector<QRect> labelRects;
+    QVector<QRect> candidateRects;
+
+    QStaticText preEditStaticText;
+    QVector<QStaticText> labelStaticTexts;
+    QVector<QStaticText> candidateStaticTexts;
+    /// vertical offset of label and candidate text inside a row
+    int labelOffset;
+    int candidateOffset;
+};
+
+#endif // PREEDITLAYOUT_H
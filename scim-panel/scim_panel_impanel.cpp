@@ -20,8 +20,14 @@
  */
 
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #define Uses_SCIM_CONFIG
 #define Uses_SCIM_CONFIG_MODULE
@@ -34,6 +40,8 @@
 #include "inputmethod_adaptor.h"
 #include "impanel_proxy.h"
 
+#include "../impanelproto.h"
+
 using namespace scim;
 
 static PanelAgent* panel_agent = 0;
@@ -92,6 +100,181 @@ static String PanelFactoryInfo2String(const PanelFactoryInfo& info)
     return ss.str();
 }
 
+/**
+ * private binary transport to kimtoy, see impanelproto.h
+ * writes come from the panel agent thread, connects from the dbus one
+ */
+class PanelSocket
+{
+public:
+    PanelSocket() : m_fd(-1) {
+        pthread_mutex_init(&m_mutex, 0);
+    }
+    ~PanelSocket() {
+        close();
+        pthread_mutex_destroy(&m_mutex);
+    }
+    void connect() {
+        const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if (!runtime_dir)
+            return;
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        String path = String(runtime_dir) + "/" + IMPANEL_SOCKET_NAME;
+        if (path.length() >= sizeof(addr.sun_path))
+            return;
+        strcpy(addr.sun_path, path.c_str());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+            return;
+        if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            // older kimtoy, stay on dbus
+            ::close(fd);
+            fd = -1;
+        }
+
+        pthread_mutex_lock(&m_mutex);
+        closeLocked();
+        m_fd = fd;
+        pthread_mutex_unlock(&m_mutex);
+    }
+    void close() {
+        pthread_mutex_lock(&m_mutex);
+        closeLocked();
+        pthread_mutex_unlock(&m_mutex);
+    }
+    bool sendBool(int type, bool b) {
+        String payload;
+        appendBool(payload, b);
+        return send(type, payload);
+    }
+    bool sendInt(int type, int i) {
+        String payload;
+        appendInt(payload, i);
+        return send(type, payload);
+    }
+    bool sendInts(int type, int i1, int i2) {
+        String payload;
+        appendInt(payload, i1);
+        appendInt(payload, i2);
+        return send(type, payload);
+    }
+    bool sendStrings(int type, const String& s1, const String& s2) {
+        String payload;
+        appendString(payload, s1);
+        appendString(payload, s2);
+        return send(type, payload);
+    }
+    bool sendLookupTable(const std::vector<String>& labels,
+                         const std::vector<String>& candidates,
+                         const std::vector<String>& attrs,
+                         bool hasprev, bool hasnext) {
+        String payload;
+        appendStringList(payload, labels);
+        appendStringList(payload, candidates);
+        appendStringList(payload, attrs);
+        appendBool(payload, hasprev);
+        appendBool(payload, hasnext);
+        return send(IMPANEL_UPDATE_LOOKUPTABLE, payload);
+    }
+private:
+    static void appendBool(String& payload, bool b) {
+        payload += (char)(b ? 1 : 0);
+    }
+    static void appendInt(String& payload, int32_t i) {
+        payload.append((const char*)&i, sizeof(i));
+    }
+    static void appendString(String& payload, const String& str) {
+        appendInt(payload, str.length());
+        payload += str;
+    }
+    static void appendStringList(String& payload, const std::vector<String>& list) {
+        appendInt(payload, list.size());
+        for (size_t i = 0; i < list.size(); ++i) {
+            appendString(payload, list[i]);
+        }
+    }
+    void closeLocked() {
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        m_pending.clear();
+    }
+    static int64_t monotonicMs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+    /// write the pending bytes, waiting a little for a busy kimtoy, true once all are out
+    bool flushLocked() {
+        const int64_t deadline = monotonicMs() + IMPANEL_DRAIN_TIMEOUT;
+        size_t sent = 0;
+        while (sent < m_pending.length()) {
+            ssize_t n = ::send(m_fd, m_pending.data() + sent, m_pending.length() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n >= 0) {
+                sent += n;
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // kimtoy went away
+                closeLocked();
+                return false;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = m_fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            int timeout = deadline - monotonicMs();
+            if (timeout <= 0 || poll(&pfd, 1, timeout) == 0)
+                break;
+        }
+        m_pending.erase(0, sent);
+        return m_pending.empty();
+    }
+    bool send(int type, const String& payload) {
+        bool ok = false;
+        pthread_mutex_lock(&m_mutex);
+        if (m_fd == -1) {
+            pthread_mutex_unlock(&m_mutex);
+            return false;
+        }
+
+        if (payload.length() > IMPANEL_MAX_PAYLOAD) {
+            // goes over dbus, the updates queued before it have to arrive first
+            if (!flushLocked())
+                closeLocked();
+            pthread_mutex_unlock(&m_mutex);
+            return false;
+        }
+
+        uint32_t header[2] = { (uint32_t)payload.length(), (uint32_t)type };
+        m_pending.append((const char*)header, sizeof(header));
+        m_pending += payload;
+
+        // a partial message stays queued, the next send finishes it
+        if (flushLocked() || (m_fd != -1 && m_pending.length() <= IMPANEL_MAX_QUEUE)) {
+            ok = true;
+        }
+        else {
+            // kimtoy stopped reading, the queued updates are stale anyway
+            closeLocked();
+        }
+        pthread_mutex_unlock(&m_mutex);
+        return ok;
+    }
+    int m_fd;
+    /// bytes kimtoy has not taken yet
+    String m_pending;
+    pthread_mutex_t m_mutex;
+};
+
 class Panel : public org::kde::kimpanel::inputmethod_adaptor,
               public org::kde::impanel_proxy,
               public DBus::IntrospectableAdaptor,
@@ -102,8 +285,128 @@ class Panel : public org::kde::kimpanel::inputmethod_adaptor,
 public:
     explicit Panel(DBus::Connection &connection)
         : DBus::ObjectAdaptor(connection, "/kimpanel"),
-        DBus::ObjectProxy(connection, "/org/kde/impanel", "org.kde.impanel") {}
-    virtual ~Panel() {}
+        DBus::ObjectProxy(connection, "/org/kde/impanel", "org.kde.impanel") {
+        pthread_mutex_init(&m_sentMutex, 0);
+        forgetSentState();
+        // kimtoy may be up already
+        m_socket.connect();
+    }
+    virtual ~Panel() {
+        pthread_mutex_destroy(&m_sentMutex);
+    }
+
+    /// property signals, only the entries that changed since the last ones sent
+    void RegisterProperties(const std::vector<std::string>& props) {
+        std::vector<String> changed;
+        pthread_mutex_lock(&m_sentMutex);
+        if (props == m_sentProperties) {
+            pthread_mutex_unlock(&m_sentMutex);
+            return;
+        }
+        bool sameKeys = props.size() == m_sentProperties.size();
+        for (size_t i = 0; sameKeys && i < props.size(); ++i) {
+            sameKeys = PropertyKey(props[i]) == PropertyKey(m_sentProperties[i]);
+            if (props[i] != m_sentProperties[i])
+                changed.push_back(props[i]);
+        }
+        m_sentProperties = props;
+        pthread_mutex_unlock(&m_sentMutex);
+
+        if (!sameKeys) {
+            inputmethod_adaptor::RegisterProperties(props);
+            return;
+        }
+        for (size_t i = 0; i < changed.size(); ++i) {
+            inputmethod_adaptor::UpdateProperty(changed[i]);
+        }
+    }
+    void UpdateProperty(const std::string& prop) {
+        const String key = PropertyKey(prop);
+        pthread_mutex_lock(&m_sentMutex);
+        for (size_t i = 0; i < m_sentProperties.size(); ++i) {
+            if (PropertyKey(m_sentProperties[i]) != key)
+                continue;
+            if (m_sentProperties[i] == prop) {
+                pthread_mutex_unlock(&m_sentMutex);
+                return;
+            }
+            m_sentProperties[i] = prop;
+            break;
+        }
+        pthread_mutex_unlock(&m_sentMutex);
+        inputmethod_adaptor::UpdateProperty(prop);
+    }
+
+    /// preedit bar signals, sent over the private socket when connected
+    void ShowPreedit(const bool& toshow) {
+        if (!m_socket.sendBool(IMPANEL_SHOW_PREEDIT, toshow))
+            inputmethod_adaptor::ShowPreedit(toshow);
+    }
+    void ShowAux(const bool& toshow) {
+        if (!m_socket.sendBool(IMPANEL_SHOW_AUX, toshow))
+            inputmethod_adaptor::ShowAux(toshow);
+    }
+    void ShowLookupTable(const bool& toshow) {
+        if (!m_socket.sendBool(IMPANEL_SHOW_LOOKUPTABLE, toshow))
+            inputmethod_adaptor::ShowLookupTable(toshow);
+    }
+    void UpdatePreeditText(const std::string& text, const std::string& attr) {
+        if (!m_socket.sendStrings(IMPANEL_UPDATE_PREEDIT_TEXT, text, attr))
+            inputmethod_adaptor::UpdatePreeditText(text, attr);
+    }
+    void UpdatePreeditCaret(const int32_t& pos) {
+        if (!m_socket.sendInt(IMPANEL_UPDATE_PREEDIT_CARET, pos))
+            inputmethod_adaptor::UpdatePreeditCaret(pos);
+    }
+    void UpdateAux(const std::string& text, const std::string& attr) {
+        if (!m_socket.sendStrings(IMPANEL_UPDATE_AUX, text, attr))
+            inputmethod_adaptor::UpdateAux(text, attr);
+    }
+    void UpdateLookupTable(const std::vector<std::string>& labels,
+                           const std::vector<std::string>& candidates,
+                           const std::vector<std::string>& attrs,
+                           const bool& hasprev,
+                           const bool& hasnext) {
+        // an unchanged page leaves only the cursor to be sent
+        pthread_mutex_lock(&m_sentMutex);
+        bool changed = !m_sentLookupTable
+                       || labels != m_sentLabels
+                       || candidates != m_sentCandidates
+                       || attrs != m_sentAttrs
+                       || hasprev != m_sentHasPrev
+                       || hasnext != m_sentHasNext;
+        if (changed) {
+            m_sentLookupTable = true;
+            m_sentLabels = labels;
+            m_sentCandidates = candidates;
+            m_sentAttrs = attrs;
+            m_sentHasPrev = hasprev;
+            m_sentHasNext = hasnext;
+            m_sentCursor = -1;
+        }
+        pthread_mutex_unlock(&m_sentMutex);
+        if (!changed)
+            return;
+
+        if (!m_socket.sendLookupTable(labels, candidates, attrs, hasprev, hasnext))
+            inputmethod_adaptor::UpdateLookupTable(labels, candidates, attrs, hasprev, hasnext);
+    }
+    void UpdateLookupTableCursor(const int32_t& pos) {
+        pthread_mutex_lock(&m_sentMutex);
+        bool changed = pos != m_sentCursor;
+        m_sentCursor = pos;
+        pthread_mutex_unlock(&m_sentMutex);
+        if (!changed)
+            return;
+
+        if (!m_socket.sendInt(IMPANEL_UPDATE_LOOKUPTABLE_CURSOR, pos))
+            inputmethod_adaptor::UpdateLookupTableCursor(pos);
+    }
+    void UpdateSpotLocation(const int32_t& x, const int32_t& y) {
+        if (!m_socket.sendInts(IMPANEL_UPDATE_SPOT_LOCATION, x, y))
+            inputmethod_adaptor::UpdateSpotLocation(x, y);
+    }
+
     virtual void MovePreeditCaret(const int32_t& pos) {
         panel_agent->move_preedit_caret(pos);
     }
@@ -151,6 +454,9 @@ public:
         }
     }
     virtual void PanelCreated() {
+        // a new panel knows nothing yet
+        forgetSentState();
+
         std::vector<String> list;
 
         // logo prop
@@ -192,6 +498,9 @@ public:
         list.push_back(Property2String(show_help_prop));
 
         this->RegisterProperties(list);
+
+        // a restarted kimtoy listens on a fresh socket
+        m_socket.connect();
     }
     virtual void Exit() {
         panel_agent->exit();
@@ -210,12 +519,95 @@ public:
         }
     }
 private:
+    static String PropertyKey(const String& prop) {
+        return prop.substr(0, prop.find(':'));
+    }
+    void forgetSentState() {
+        pthread_mutex_lock(&m_sentMutex);
+        m_sentProperties.clear();
+        m_sentLookupTable = false;
+        m_sentCursor = -1;
+        pthread_mutex_unlock(&m_sentMutex);
+    }
+    PanelSocket m_socket;
+    /// last state sent, touched by the panel agent and dbus threads
+    pthread_mutex_t m_sentMutex;
+    std::vector<String> m_sentProperties;
+    bool m_sentLookupTable;
+    std::vector<String> m_sentLabels;
+    std::vector<String> m_sentCandidates;
+    std::vector<String> m_sentAttrs;
+    bool m_sentHasPrev;
+    bool m_sentHasNext;
+    int m_sentCursor;
 };
 
 
 DBus::BusDispatcher dispatcher;
 static Panel* panel = 0;
 
+/**
+ * preedit bar state changed inside one panel agent transaction
+ * only the last value of each part is sent when the transaction ends,
+ * all of it is touched by the panel agent thread only
+ */
+struct PreeditSnapshot
+{
+    enum Part {
+        SpotLocation        = 1 << 0,
+        PreeditText         = 1 << 1,
+        PreeditCaret        = 1 << 2,
+        AuxText             = 1 << 3,
+        LookupTable         = 1 << 4,
+        PreeditVisible      = 1 << 5,
+        AuxVisible          = 1 << 6,
+        LookupTableVisible  = 1 << 7
+    };
+    PreeditSnapshot() : dirty(0) {}
+    int dirty;
+    int spot_x, spot_y;
+    String preedit_text, preedit_attrs;
+    int preedit_caret;
+    String aux_text, aux_attrs;
+    std::vector<String> labels, candidates, attrs;
+    bool hasprev, hasnext;
+    int cursor_pos;
+    bool preedit_visible, aux_visible, lookup_table_visible;
+};
+
+static PreeditSnapshot snapshot;
+static int transaction_depth = 0;
+
+static void flush_snapshot()
+{
+    if (transaction_depth > 0 || !snapshot.dirty)
+        return;
+
+    int dirty = snapshot.dirty;
+    snapshot.dirty = 0;
+
+    // contents before visibility so that a shown bar never paints stale text
+    if (dirty & PreeditSnapshot::SpotLocation)
+        panel->UpdateSpotLocation(snapshot.spot_x, snapshot.spot_y);
+    if (dirty & PreeditSnapshot::PreeditText)
+        panel->UpdatePreeditText(snapshot.preedit_text, snapshot.preedit_attrs);
+    if (dirty & PreeditSnapshot::PreeditCaret)
+        panel->UpdatePreeditCaret(snapshot.preedit_caret);
+    if (dirty & PreeditSnapshot::AuxText)
+        panel->UpdateAux(snapshot.aux_text, snapshot.aux_attrs);
+    if (dirty & PreeditSnapshot::LookupTable) {
+        panel->UpdateLookupTable(snapshot.labels, snapshot.candidates, snapshot.attrs,
+                                 snapshot.hasprev, snapshot.hasnext);
+        panel->UpdateLookupTableCursor(snapshot.cursor_pos);
+    }
+    if (dirty & PreeditSnapshot::PreeditVisible)
+        panel->ShowPreedit(snapshot.preedit_visible);
+    if (dirty & PreeditSnapshot::AuxVisible)
+        panel->ShowAux(snapshot.aux_visible);
+    if (dirty & PreeditSnapshot::LookupTableVisible)
+        panel->ShowLookupTable(snapshot.lookup_table_visible);
+}
+
 static void slot_transaction_start(void);
 static void slot_transaction_end(void);
 static void slot_reload_config(void);
@@ -329,14 +721,14 @@ static void start_auto_start_helpers()
 
 static void slot_transaction_start(void)
 {
-    std::cerr << "slot_transaction_start\n";
-//     _transaction_lock.lock();
+    ++transaction_depth;
 }
 
 static void slot_transaction_end(void)
 {
-    std::cerr << "slot_transaction_end\n";
-//     _transaction_lock.unlock();
+    if (transaction_depth > 0)
+        --transaction_depth;
+    flush_snapshot();
 }
 
 static void slot_reload_config(void)
@@ -386,59 +778,85 @@ static void slot_show_factory_menu(const std::vector<PanelFactoryInfo>& factorie
 
 static void slot_update_spot_location(int x, int y)
 {
-    panel->UpdateSpotLocation(x, y);
+    snapshot.spot_x = x;
+    snapshot.spot_y = y;
+    snapshot.dirty |= PreeditSnapshot::SpotLocation;
+    flush_snapshot();
 }
 
 static void slot_show_preedit_string(void)
 {
-    panel->ShowPreedit(true);
+    snapshot.preedit_visible = true;
+    snapshot.dirty |= PreeditSnapshot::PreeditVisible;
+    flush_snapshot();
 }
 
 static void slot_show_aux_string(void)
 {
-    panel->ShowAux(true);
+    snapshot.aux_visible = true;
+    snapshot.dirty |= PreeditSnapshot::AuxVisible;
+    flush_snapshot();
 }
 
 static void slot_show_lookup_table(void)
 {
-    panel->ShowLookupTable(true);
+    snapshot.lookup_table_visible = true;
+    snapshot.dirty |= PreeditSnapshot::LookupTableVisible;
+    flush_snapshot();
 }
 
 static void slot_hide_preedit_string(void)
 {
-    panel->ShowPreedit(false);
+    snapshot.preedit_visible = false;
+    snapshot.dirty |= PreeditSnapshot::PreeditVisible;
+    flush_snapshot();
 }
 
 static void slot_hide_aux_string(void)
 {
-    panel->ShowAux(false);
+    snapshot.aux_visible = false;
+    snapshot.dirty |= PreeditSnapshot::AuxVisible;
+    flush_snapshot();
 }
 
 static void slot_hide_lookup_table(void)
 {
-    panel->ShowLookupTable(false);
+    snapshot.lookup_table_visible = false;
+    snapshot.dirty |= PreeditSnapshot::LookupTableVisible;
+    flush_snapshot();
 }
 
 static void slot_update_preedit_string(const String& str, const AttributeList& attrs)
 {
-    panel->UpdatePreeditText(str, AttrList2String(attrs));
+    snapshot.preedit_text = str;
+    snapshot.preedit_attrs = AttrList2String(attrs);
+    snapshot.dirty |= PreeditSnapshot::PreeditText;
+    flush_snapshot();
 }
 
 static void slot_update_preedit_caret(int caret)
 {
-    panel->UpdatePreeditCaret(caret);
+    snapshot.preedit_caret = caret;
+    snapshot.dirty |= PreeditSnapshot::PreeditCaret;
+    flush_snapshot();
 }
 
 static void slot_update_aux_string(const String& str, const AttributeList& attrs)
 {
-    panel->UpdateAux(str, AttrList2String(attrs));
+    snapshot.aux_text = str;
+    snapshot.aux_attrs = AttrList2String(attrs);
+    snapshot.dirty |= PreeditSnapshot::AuxText;
+    flush_snapshot();
 }
 
 static void slot_update_lookup_table(const LookupTable& table)
 {
-    std::vector<String> labels;
-    std::vector<String> candidates;
-    std::vector<String> attrs;
+    std::vector<String>& labels = snapshot.labels;
+    std::vector<String>& candidates = snapshot.candidates;
+    std::vector<String>& attrs = snapshot.attrs;
+    labels.clear();
+    candidates.clear();
+    attrs.clear();
     size_t current_page_size = table.get_current_page_size();
     for (size_t i = 0; i < current_page_size; ++i) {
         labels.push_back(utf8_wcstombs(table.get_candidate_label(i)));
@@ -447,12 +865,11 @@ static void slot_update_lookup_table(const LookupTable& table)
         candidates.push_back(utf8_wcstombs(table.get_candidate_in_current_page(i)));
         attrs.push_back(AttrList2String(table.get_attributes_in_current_page(i)));
     }
-    bool hasprev = table.get_current_page_start();
-    bool hasnext = table.get_current_page_start() + current_page_size < table.number_of_candidates();
-    panel->UpdateLookupTable(labels, candidates, attrs, hasprev, hasnext);
-
-    int cursor_pos = table.get_cursor_pos_in_current_page();
-    panel->UpdateLookupTableCursor(cursor_pos);
+    snapshot.hasprev = table.get_current_page_start();
+    snapshot.hasnext = table.get_current_page_start() + current_page_size < table.number_of_candidates();
+    snapshot.cursor_pos = table.get_cursor_pos_in_current_page();
+    snapshot.dirty |= PreeditSnapshot::LookupTable;
+    flush_snapshot();
 }
 
 static void slot_register_properties(const PropertyList& props)
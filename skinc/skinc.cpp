@@ -0,0 +1,251 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QDataStream>
+#include <QDebug>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QtAlgorithms>
+
+#include <string.h>
+
+#include "../compiledskin.h"
+#include "../kimgio-apng/apng.h"
+#include "../skinsource.h"
+
+/// upper bound of frames taken from one image, same as the frame store
+static const int MAX_FRAMES = 1024;
+
+/// minimum atlas width, wider frames widen the atlas
+static const int ATLAS_WIDTH = 1024;
+
+/// the atlas starts on a page boundary so that it maps cleanly
+static const qint64 ATLAS_ALIGN = 4096;
+
+struct Frame {
+    QImage image;
+    int delay;
+    int x, y;
+};
+
+struct Entry {
+    QByteArray name;
+    QByteArray data;
+    QVector<Frame> frames;
+    int loopCount;
+};
+
+static bool decodeFrames(const QString& name, const QByteArray& data, QVector<Frame>& frames, int& loopCount)
+{
+    QByteArray format;
+    if (name.endsWith(".gif", Qt::CaseInsensitive))
+        format = "gif";
+    else if (name.endsWith(".png", Qt::CaseInsensitive) && QImageReader::supportedImageFormats().contains("apng"))
+        format = "apng";
+
+    QBuffer buffer;
+    buffer.setData(data);
+    /// one pass over the frames, keep the apng handler from caching them
+    buffer.setProperty(APNG_FRAME_CACHE_PROPERTY, false);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, format);
+    if (!reader.canRead())
+        return false;
+
+    while ((int)frames.count() < MAX_FRAMES && reader.canRead()) {
+        Frame f;
+        f.image = reader.read();
+        if (f.image.isNull())
+            break;
+        f.image = f.image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        f.delay = reader.nextImageDelay();
+        f.x = 0;
+        f.y = 0;
+        frames.append(f);
+
+        /// the apng reader rewinds by itself after the last frame
+        if (reader.imageCount() > 0 && frames.count() >= reader.imageCount())
+            break;
+    }
+
+    loopCount = reader.loopCount();
+    return !frames.isEmpty();
+}
+
+static bool taller(const Frame* a, const Frame* b)
+{
+    return a->image.height() > b->image.height();
+}
+
+/// shelf packing, tallest frames first
+static QSize packAtlas(QVector<Entry>& entries)
+{
+    QList<Frame*> frames;
+    int width = ATLAS_WIDTH;
+    for (int i = 0; i < entries.count(); ++i) {
+        for (int j = 0; j < entries[i].frames.count(); ++j) {
+            Frame* f = &entries[i].frames[j];
+            frames.append(f);
+            width = qMax(width, f->image.width());
+        }
+    }
+    qStableSort(frames.begin(), frames.end(), taller);
+
+    int x = 0, y = 0, shelfHeight = 0;
+    foreach (Frame* f, frames) {
+        if (x + f->image.width() > width) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        f->x = x;
+        f->y = y;
+        x += f->image.width();
+        shelfHeight = qMax(shelfHeight, f->image.height());
+    }
+
+    return QSize(width, y + shelfHeight);
+}
+
+static bool writeSkin(const QString& file, CompiledSkin::SourceType type, QVector<Entry>& entries)
+{
+    QSize atlasSize = packAtlas(entries);
+
+    /// header, then the index whose size is known up front
+    qint64 offset = 8 + 4 * 5 + 8;
+    foreach (const Entry& e, entries) {
+        offset += 4 + e.name.size() + 1;
+        offset += e.frames.isEmpty() ? 4 + 4 : 4 + e.frames.count() * 5 * 4;
+    }
+    qint64 blobOffset = offset;
+    foreach (const Entry& e, entries)
+        offset += e.data.size();
+    qint64 atlasOffset = (offset + ATLAS_ALIGN - 1) / ATLAS_ALIGN * ATLAS_ALIGN;
+
+    QSaveFile out(file);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "cannot write" << file;
+        return false;
+    }
+
+    QDataStream ds(&out);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    ds.writeRawData(COMPILEDSKIN_MAGIC, 8);
+    ds << (quint32)COMPILEDSKIN_VERSION << (quint32)type << (quint32)entries.count()
+       << (quint32)atlasSize.width() << (quint32)atlasSize.height() << (quint64)atlasOffset;
+
+    offset = blobOffset;
+    foreach (const Entry& e, entries) {
+        ds << e.name;
+        if (e.frames.isEmpty()) {
+            ds << (quint8)CompiledSkin::DataEntry << (quint32)offset << (quint32)e.data.size();
+            offset += e.data.size();
+            continue;
+        }
+        ds << (quint8)CompiledSkin::ImageEntry << (quint32)e.frames.count() << (qint32)e.loopCount;
+        foreach (const Frame& f, e.frames) {
+            ds << (quint32)f.x << (quint32)f.y << (quint32)f.image.width() << (quint32)f.image.height()
+               << (qint32)f.delay;
+        }
+    }
+
+    foreach (const Entry& e, entries)
+        ds.writeRawData(e.data.constData(), e.data.size());
+
+    QByteArray padding(atlasOffset - offset, '\0');
+    ds.writeRawData(padding.constData(), padding.size());
+
+    /// compose the atlas row by row into the file
+    QImage atlas(atlasSize, QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+    foreach (const Entry& e, entries) {
+        foreach (const Frame& f, e.frames) {
+            for (int y = 0; y < f.image.height(); ++y) {
+                memcpy(atlas.scanLine(f.y + y) + f.x * 4, f.image.constScanLine(y), f.image.width() * 4);
+            }
+        }
+    }
+    for (int y = 0; y < atlas.height(); ++y)
+        ds.writeRawData((const char*)atlas.constScanLine(y), atlas.width() * 4);
+
+    if (ds.status() != QDataStream::Ok || !out.commit()) {
+        qWarning() << "cannot write" << file;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    /// image plugins such as apng are found through the application
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("kimtoy-skinc");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compile a sogou .ssf or fcitx .fskin skin for KIMToy");
+    parser.addHelpOption();
+    parser.addPositionalArgument("skin", "Skin file to compile");
+    parser.addPositionalArgument("output", "Compiled skin, next to the source by default", "[output]");
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.isEmpty() || args.count() > 2)
+        parser.showHelp(1);
+
+    QString input = args.at(0);
+    CompiledSkin::SourceType type = CompiledSkin::InvalidSource;
+    if (input.endsWith(".ssf"))
+        type = CompiledSkin::SogouSource;
+    else if (input.endsWith(".fskin"))
+        type = CompiledSkin::FcitxSource;
+
+    QScopedPointer<SkinSource> source(type == CompiledSkin::InvalidSource ? 0 : SkinSource::open(input));
+    if (!source) {
+        qWarning() << "cannot open skin" << input;
+        return 1;
+    }
+
+    QString output = args.count() > 1 ? args.at(1)
+                     : QFileInfo(input).absolutePath() + '/' + QFileInfo(input).completeBaseName() + COMPILEDSKIN_SUFFIX;
+
+    QVector<Entry> entries;
+    foreach (const QString& name, source->entries()) {
+        Entry e;
+        e.name = name.toUtf8();
+        e.loopCount = -1;
+        QByteArray data = source->data(name);
+        if (!decodeFrames(name, data, e.frames, e.loopCount))
+            e.data = data;
+        entries.append(e);
+    }
+
+    if (!writeSkin(output, type, entries))
+        return 1;
+
+    return 0;
+}
@@ -21,8 +21,6 @@
 
 #include "skinpixmap.h"
 
-#include <QBitmap>
-#include <QMatrix>
 #include <QPainter>
 #include <QSize>
 
@@ -35,10 +33,15 @@
  * --------hsl-------hsr-------skinw-----skinh
  */
 
+/// number of composed backgrounds kept per skin
+static const int MAX_CACHED_PIXMAPS = 4;
+
 SkinPixmap::SkinPixmap()
 {
     m_skinw = 0;
     m_skinh = 0;
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
 }
 
 SkinPixmap::SkinPixmap(const QPixmap& skinpix, int hsl, int hsr, int vst, int vsb, int hstm, int vstm)
@@ -48,6 +51,8 @@ SkinPixmap::SkinPixmap(const QPixmap& skinpix, int hsl, int hsr, int vst, int vs
     m_hsl = hsl, m_hsr = hsr;
     m_vst = vst, m_vsb = vsb;
     m_hstm = hstm, m_vstm = vstm;
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
     if (hsl != 0 && vst != 0)
         o_topleft = skinpix.copy(0, 0, hsl, vst);
     if (hsr - hsl != 0 && vst != 0)
@@ -67,153 +72,120 @@ SkinPixmap::SkinPixmap(const QPixmap& skinpix, int hsl, int hsr, int vst, int vs
     if (m_skinw - hsr != 0 && m_skinh - vsb != 0)
         o_bottomright = skinpix.copy(hsr, vsb, m_skinw - hsr, m_skinh - vsb);
 
-    m_topleftRegion = o_topleft.mask();
-    m_topRegion = o_top.mask();
-    m_toprightRegion = o_topright.mask();
-    m_leftRegion = o_left.mask();
-    m_centerRegion = o_center.mask();
-    m_rightRegion = o_right.mask();
-    m_bottomleftRegion = o_bottomleft.mask();
-    m_bottomRegion = o_bottom.mask();
-    m_bottomrightRegion = o_bottomright.mask();
+    m_topleftMask = SpanMask::fromPixmap(o_topleft);
+    m_topMask = SpanMask::fromPixmap(o_top);
+    m_toprightMask = SpanMask::fromPixmap(o_topright);
+    m_leftMask = SpanMask::fromPixmap(o_left);
+    m_centerMask = SpanMask::fromPixmap(o_center);
+    m_rightMask = SpanMask::fromPixmap(o_right);
+    m_bottomleftMask = SpanMask::fromPixmap(o_bottomleft);
+    m_bottomMask = SpanMask::fromPixmap(o_bottom);
+    m_bottomrightMask = SpanMask::fromPixmap(o_bottomright);
 }
 
 void SkinPixmap::resizeRegion(const QSize& size)
 {
-    const int middlepixh = m_vsb - m_vst;
-    const int middlepixw = m_hsr - m_hsl;
-
     const int leftrightheight = size.height() - m_vst - (m_skinh - m_vsb);
     const int topbottomwidth = size.width() - m_hsl - (m_skinw - m_hsr);
 
-    qreal scaleX = m_hstm ? 1 : (qreal)topbottomwidth / (qreal)middlepixw;
-    qreal scaleY = m_vstm ? 1 : (qreal)leftrightheight / (qreal)middlepixh;
+    SpanMask mask(size.width(), size.height());
 
     /// corners
-    QRegion topleft = m_topleftRegion;
-    QRegion topright = m_toprightRegion;
-    topright.translate(m_hsl + topbottomwidth, 0);
-    QRegion bottomleft = m_bottomleftRegion;
-    bottomleft.translate(0, m_vst + leftrightheight);
-    QRegion bottomright = m_bottomrightRegion;
-    bottomright.translate(m_hsl + topbottomwidth, m_vst + leftrightheight);
+    mask.unite(m_topleftMask, 0, 0);
+    mask.unite(m_toprightMask, m_hsl + topbottomwidth, 0);
+    mask.unite(m_bottomleftMask, 0, m_vst + leftrightheight);
+    mask.unite(m_bottomrightMask, m_hsl + topbottomwidth, m_vst + leftrightheight);
 
     /// edges
-    QRegion left, top, right, bottom;
     if (m_hstm == 0) {
         /// scale
-        QMatrix scaleXMatrix;
-        scaleXMatrix.scale(scaleX, 1.0);
-        top = m_topRegion * scaleXMatrix;
-        bottom = m_bottomRegion * scaleXMatrix;
+        mask.unite(m_topMask.scaled(topbottomwidth, m_topMask.height()), m_hsl, 0);
+        mask.unite(m_bottomMask.scaled(topbottomwidth, m_bottomMask.height()), m_hsl, m_vst + leftrightheight);
     }
     else {
         /// tilling
-        top = QRegion(QRect(0, 0, topbottomwidth, m_vst));
-        bottom = QRegion(QRect(0, 0, topbottomwidth, o_bottom.height()));
-        QRegion toppixRegion(m_topRegion);
-        QRegion bottompixRegion(m_bottomRegion);
-        QRegion tmpRegion = toppixRegion;
-        QRegion tmp2Region = bottompixRegion;
-        for (int i = 0; i < topbottomwidth; i += middlepixw) {
-            toppixRegion |= tmpRegion;
-            bottompixRegion |= tmp2Region;
-            tmpRegion.translate(middlepixw, 0);
-            tmp2Region.translate(middlepixw, 0);
-        }
-        top &= toppixRegion;
-        bottom &= bottompixRegion;
+        mask.unite(m_topMask.tiled(topbottomwidth, m_topMask.height()), m_hsl, 0);
+        mask.unite(m_bottomMask.tiled(topbottomwidth, m_bottomMask.height()), m_hsl, m_vst + leftrightheight);
     }
     if (m_vstm == 0) {
         /// scale
-        QMatrix scaleYMatrix;
-        scaleYMatrix.scale(1.0, scaleY);
-        left = m_leftRegion * scaleYMatrix;
-        right = m_rightRegion * scaleYMatrix;
+        mask.unite(m_leftMask.scaled(m_leftMask.width(), leftrightheight), 0, m_vst);
+        mask.unite(m_rightMask.scaled(m_rightMask.width(), leftrightheight), m_hsl + topbottomwidth, m_vst);
     }
     else {
         /// tilling
-        left = QRegion(QRect(0, 0, m_hsl, leftrightheight));
-        right = QRegion(QRect(0, 0, o_right.width(), leftrightheight));
-        QRegion leftpixRegion(m_leftRegion);
-        QRegion rightpixRegion(m_rightRegion);
-        QRegion tmpRegion = leftpixRegion;
-        QRegion tmp2Region = rightpixRegion;
-        for (int i = 0; i < leftrightheight; i += middlepixh) {
-            leftpixRegion |= tmpRegion;
-            rightpixRegion |= tmp2Region;
-            tmpRegion.translate(0, middlepixh);
-            tmp2Region.translate(0, middlepixh);
-        }
-        left &= leftpixRegion;
-        right &= rightpixRegion;
+        mask.unite(m_leftMask.tiled(m_leftMask.width(), leftrightheight), 0, m_vst);
+        mask.unite(m_rightMask.tiled(m_rightMask.width(), leftrightheight), m_hsl + topbottomwidth, m_vst);
     }
-    left.translate(0, m_vst);
-    top.translate(m_hsl, 0);
-    right.translate(m_hsl + topbottomwidth, m_vst);
-    bottom.translate(m_hsl, m_vst + leftrightheight);
 
     /// center
-    QRegion center(QRect(0, 0, topbottomwidth, leftrightheight));
+    SpanMask center;
     if (m_hstm == 0) {
         /// scale
         if (m_vstm == 0) {
             /// scale
-            QMatrix scaleXYMatrix;
-            scaleXYMatrix.scale(scaleX, scaleY);
-            center = m_centerRegion * scaleXYMatrix;
+            center = m_centerMask.scaled(topbottomwidth, leftrightheight);
         }
         else {
             /// tilling
-            QMatrix scaleXMatrix;
-            scaleXMatrix.scale(scaleX, 1.0);
-            QRegion centerpixRegion(m_centerRegion * scaleXMatrix);
-            QRegion tmpRegion = centerpixRegion;
-            int i;
-            for (i = 0; i < leftrightheight; i += middlepixh) {
-                centerpixRegion |= tmpRegion;
-                tmpRegion.translate(0, middlepixh);
-            }
-            center &= centerpixRegion;
+            center = m_centerMask.scaled(topbottomwidth, m_centerMask.height()).tiled(topbottomwidth, leftrightheight);
         }
     }
     else {
         /// tilling
         if (m_vstm == 0) {
             /// scale
-            QMatrix scaleYMatrix;
-            scaleYMatrix.scale(1.0, scaleY);
-            QRegion centerpixRegion(m_centerRegion * scaleYMatrix);
-            QRegion tmpRegion = centerpixRegion;
-            int i;
-            for (i = 0; i < topbottomwidth; i += middlepixw) {
-                centerpixRegion |= tmpRegion;
-                tmpRegion.translate(middlepixw, 0);
-            }
-            center &= centerpixRegion;
+            center = m_centerMask.scaled(m_centerMask.width(), leftrightheight).tiled(topbottomwidth, leftrightheight);
         }
         else {
             /// tilling
-            QRegion centerpixRegion(m_centerRegion);
-            QRegion tmpRegion = centerpixRegion;
-            int i, j;
-            for (i = 0; i < topbottomwidth; i += middlepixw) {
-                QRegion tmp2Region = tmpRegion;
-                for (j = 0; j < leftrightheight; j += middlepixh) {
-                    centerpixRegion |= tmp2Region;
-                    tmp2Region.translate(0, middlepixh);
-                }
-                tmpRegion.translate(middlepixw, 0);
-            }
-            center &= centerpixRegion;
+            center = m_centerMask.tiled(topbottomwidth, leftrightheight);
         }
     }
-    center.translate(m_hsl, m_vst);
+    mask.unite(center, m_hsl, m_vst);
 
-    m_currentRegion = topleft | top | topright | left | center | right | bottomleft | bottom | bottomright;
+    m_currentMask = mask;
+    m_currentRegion = mask.toRegion();
 }
 
 void SkinPixmap::drawPixmap(QPainter* p, int width, int height) const
+{
+    p->drawPixmap(0, 0, pixmap(QSize(width, height)));
+}
+
+QPixmap SkinPixmap::pixmap(const QSize& size) const
+{
+    for (int i = 0; i < m_cache.count(); ++i) {
+        const CachedPixmap& c = m_cache.at(i);
+        if (c.size == size && c.hstm == m_hstm && c.vstm == m_vstm) {
+            ++m_cacheHits;
+            if (i != 0)
+                m_cache.move(i, 0);
+            return m_cache.first().pixmap;
+        }
+    }
+
+    ++m_cacheMisses;
+
+    CachedPixmap c;
+    c.size = size;
+    c.hstm = m_hstm;
+    c.vstm = m_vstm;
+    if (!size.isEmpty()) {
+        c.pixmap = QPixmap(size);
+        c.pixmap.fill(Qt::transparent);
+        QPainter p(&c.pixmap);
+        renderPixmap(&p, size.width(), size.height());
+    }
+
+    m_cache.prepend(c);
+    while (m_cache.count() > MAX_CACHED_PIXMAPS)
+        m_cache.removeLast();
+
+    return c.pixmap;
+}
+
+void SkinPixmap::renderPixmap(QPainter* p, int width, int height) const
 {
     const int middlepixh = m_vsb - m_vst;
     const int middlepixw = m_hsr - m_hsl;
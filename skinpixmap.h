@@ -22,8 +22,12 @@
 #ifndef SKINPIXMAP_H
 #define SKINPIXMAP_H
 
+#include <QList>
 #include <QPixmap>
 #include <QRegion>
+#include <QSize>
+
+#include "spanmask.h"
 
 class SkinPixmap
 {
@@ -39,8 +43,19 @@ public:
     void resizePixmap(const QSize& size);
     void resizeRegion(const QSize& size);
     void drawPixmap(QPainter* p, int width, int height) const;
+    QPixmap pixmap(const QSize& size) const;
     QRegion currentRegion() const;
+    const SpanMask& currentMask() const {
+        return m_currentMask;
+    }
+    int cacheHits() const {
+        return m_cacheHits;
+    }
+    int cacheMisses() const {
+        return m_cacheMisses;
+    }
 private:
+    void renderPixmap(QPainter* p, int width, int height) const;
     int m_skinw, m_skinh;
     int m_hsl, m_hsr, m_vst, m_vsb;
     int m_hstm, m_vstm;// stretch mode, 0->scale, 1->repeat
@@ -49,10 +64,21 @@ private:
     QPixmap o_left,       o_center,     o_right;
     QPixmap o_bottomleft, o_bottom,     o_bottomright;
 
-    QRegion m_topleftRegion, m_topRegion, m_toprightRegion;
-    QRegion m_leftRegion, m_centerRegion, m_rightRegion;
-    QRegion m_bottomleftRegion, m_bottomRegion, m_bottomrightRegion;
+    SpanMask m_topleftMask, m_topMask, m_toprightMask;
+    SpanMask m_leftMask, m_centerMask, m_rightMask;
+    SpanMask m_bottomleftMask, m_bottomMask, m_bottomrightMask;
+    SpanMask m_currentMask;
     QRegion m_currentRegion;
+
+    /// composed background cache, most recently used first
+    struct CachedPixmap {
+        QSize size;
+        int hstm, vstm;
+        QPixmap pixmap;
+    };
+    mutable QList<CachedPixmap> m_cache;
+    mutable int m_cacheHits;
+    mutable int m_cacheMisses;
 };
 
 #endif // SKINPIXMAP_H
@@ -0,0 +1,191 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "skinsource.h"
+
+#include <QFile>
+#include <QScopedPointer>
+
+#include <KArchive>
+#include <KTar>
+
+#include "compiledskin.h"
+#include "framestore.h"
+#include "kssf.h"
+#include "themecache.h"
+
+class ArchiveSkinSource : public SkinSource
+{
+public:
+    explicit ArchiveSkinSource(QIODevice* device, KArchive* archive, const KArchiveDirectory* root)
+            : m_device(device), m_archive(archive), m_root(root)
+    {
+    }
+    virtual ~ArchiveSkinSource()
+    {
+        /// the archive reads from the device, so it goes first
+        delete m_archive;
+        delete m_device;
+    }
+    virtual QStringList entries() const
+    {
+        QStringList names;
+        collect(m_root, QString(), names);
+        return names;
+    }
+    virtual bool contains(const QString& name) const
+    {
+        return file(name) != 0;
+    }
+    virtual QByteArray data(const QString& name) const
+    {
+        const KArchiveFile* f = file(name);
+        return f ? f->data() : QByteArray();
+    }
+    virtual QPixmap pixmap(const QString& name) const
+    {
+        QPixmap pix;
+        const KArchiveFile* f = file(name);
+        if (f)
+            pix.loadFromData(f->data());
+        return pix;
+    }
+    virtual void loadFrames(FrameStore* store, const QString& name) const
+    {
+        const KArchiveFile* f = file(name);
+        if (f)
+            store->setData(f->data(), name.endsWith(".gif") ? "gif" : "apng");
+    }
+private:
+    const KArchiveFile* file(const QString& name) const
+    {
+        const KArchiveEntry* e = m_root->entry(name);
+        if (e && !e->symLinkTarget().isEmpty())
+            e = m_root->entry(e->symLinkTarget());
+        if (!e || !e->isFile())
+            return 0;
+        return static_cast<const KArchiveFile*>(e);
+    }
+    static void collect(const KArchiveDirectory* dir, const QString& prefix, QStringList& names)
+    {
+        foreach (const QString& name, dir->entries()) {
+            const KArchiveEntry* e = dir->entry(name);
+            if (e->isDirectory())
+                collect(static_cast<const KArchiveDirectory*>(e), prefix + name + '/', names);
+            else
+                names << prefix + name;
+        }
+    }
+    QIODevice* m_device;
+    KArchive* m_archive;
+    const KArchiveDirectory* m_root;
+};
+
+class CompiledSkinSource : public SkinSource
+{
+public:
+    explicit CompiledSkinSource()
+    {
+    }
+    bool open(const QString& file)
+    {
+        return m_skin.open(file);
+    }
+    virtual QStringList entries() const
+    {
+        return m_skin.entries();
+    }
+    virtual bool contains(const QString& name) const
+    {
+        return m_skin.contains(name);
+    }
+    virtual QByteArray data(const QString& name) const
+    {
+        return m_skin.data(name);
+    }
+    virtual QPixmap pixmap(const QString& name) const
+    {
+        QVector<QImage> frames = m_skin.frames(name);
+        if (frames.isEmpty())
+            return QPixmap();
+        return QPixmap::fromImage(frames.first());
+    }
+    virtual void loadFrames(FrameStore* store, const QString& name) const
+    {
+        QVector<int> delays;
+        int loopCount = -1;
+        QVector<QImage> frames = m_skin.frames(name, &delays, &loopCount);
+        if (!frames.isEmpty())
+            store->setFrames(frames, delays, loopCount);
+    }
+private:
+    CompiledSkin m_skin;
+};
+
+SkinSource* SkinSource::open(const QString& file)
+{
+    if (!QFile::exists(file))
+        return 0;
+
+    if (file.endsWith(COMPILEDSKIN_SUFFIX)) {
+        CompiledSkinSource* source = new CompiledSkinSource;
+        if (source->open(file))
+            return source;
+        delete source;
+        return 0;
+    }
+
+    if (file.endsWith(".ssf")) {
+        KSsf* ssf = new KSsf(file);
+        if (!ssf->open(QIODevice::ReadOnly)) {
+            delete ssf;
+            return 0;
+        }
+        return new ArchiveSkinSource(0, ssf, ssf->directory());
+    }
+
+    if (file.endsWith(".fskin")) {
+        QScopedPointer<QIODevice> dev(ThemeCache::openTar(file));
+        if (!dev)
+            return 0;
+
+        KTar* tar = new KTar(dev.data());
+        QStringList entries = tar->open(QIODevice::ReadOnly) ? tar->directory()->entries() : QStringList();
+        const KArchiveEntry* entry = entries.count() == 1 ? tar->directory()->entry(entries.first()) : 0;
+        if (!entry || !entry->isDirectory()) {
+            delete tar;
+            return 0;
+        }
+
+        const KArchiveDirectory* subdir = static_cast<const KArchiveDirectory*>(entry);
+        return new ArchiveSkinSource(dev.take(), tar, subdir);
+    }
+
+    return 0;
+}
+
+SkinSource::SkinSource()
+{
+}
+
+SkinSource::~SkinSource()
+{
+}
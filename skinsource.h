@@ -0,0 +1,59 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SKINSOURCE_H
+#define SKINSOURCE_H
+
+#include <QByteArray>
+#include <QPixmap>
+#include <QString>
+#include <QStringList>
+
+class FrameStore;
+
+/**
+ * Files of a skin, either from its archive or from a compiled skin
+ *
+ * Names are relative to the skin root, the single top directory of a
+ * fskin tarball is stripped and symlinks are resolved.
+ */
+class SkinSource
+{
+public:
+    /// open a .ssf, .fskin or compiled skin, 0 on failure
+    static SkinSource* open(const QString& file);
+    virtual ~SkinSource();
+
+    /// names of all files, images included
+    virtual QStringList entries() const = 0;
+    virtual bool contains(const QString& name) const = 0;
+    /// raw content, empty for images of a compiled skin
+    virtual QByteArray data(const QString& name) const = 0;
+    /// first frame of an image
+    virtual QPixmap pixmap(const QString& name) const = 0;
+    /// all frames of a possibly animated image
+    virtual void loadFrames(FrameStore* store, const QString& name) const = 0;
+
+protected:
+    explicit SkinSource();
+};
+
+#endif // SKINSOURCE_H
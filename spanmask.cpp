@@ -0,0 +1,235 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spanmask.h"
+
+#include <QImage>
+#include <QPixmap>
+#include <QRect>
+
+/**
+ * merge two sorted span lists, touching spans are joined
+ */
+static QVector<int> mergeSpans(const QVector<int>& a, const QVector<int>& b)
+{
+    if (a.isEmpty())
+        return b;
+    if (b.isEmpty())
+        return a;
+
+    QVector<int> r;
+    r.reserve(a.count() + b.count());
+    int i = 0, j = 0;
+    while (i < a.count() || j < b.count()) {
+        int start, end;
+        if (j >= b.count() || (i < a.count() && a.at(i) <= b.at(j))) {
+            start = a.at(i), end = a.at(i + 1);
+            i += 2;
+        }
+        else {
+            start = b.at(j), end = b.at(j + 1);
+            j += 2;
+        }
+        if (!r.isEmpty() && start <= r.last()) {
+            r.last() = qMax(r.last(), end);
+        }
+        else {
+            r.append(start);
+            r.append(end);
+        }
+    }
+    return r;
+}
+
+SpanMask::SpanMask()
+{
+    m_width = 0;
+    m_height = 0;
+}
+
+SpanMask::SpanMask(int width, int height)
+{
+    m_width = qMax(width, 0);
+    m_height = qMax(height, 0);
+    m_lines.resize(m_height);
+}
+
+SpanMask SpanMask::fromPixmap(const QPixmap& pixmap)
+{
+    if (pixmap.isNull())
+        return SpanMask();
+
+    return fromImage(pixmap.toImage());
+}
+
+SpanMask SpanMask::fromImage(const QImage& source)
+{
+    if (source.isNull())
+        return SpanMask();
+
+    const QImage image = source.convertToFormat(QImage::Format_ARGB32);
+    SpanMask mask(image.width(), image.height());
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb* rgbs = (const QRgb*)image.constScanLine(y);
+        QVector<int>& line = mask.m_lines[y];
+        int start = -1;
+        for (int x = 0; x < image.width(); ++x) {
+            /// same threshold as QPixmap::mask()
+            bool opaque = qAlpha(rgbs[x]) >= 128;
+            if (opaque && start == -1) {
+                start = x;
+            }
+            else if (!opaque && start != -1) {
+                line.append(start);
+                line.append(x);
+                start = -1;
+            }
+        }
+        if (start != -1) {
+            line.append(start);
+            line.append(image.width());
+        }
+    }
+    return mask;
+}
+
+bool SpanMask::isEmpty() const
+{
+    foreach (const QVector<int>& line, m_lines) {
+        if (!line.isEmpty())
+            return false;
+    }
+    return true;
+}
+
+SpanMask SpanMask::scaled(int width, int height) const
+{
+    SpanMask mask(width, height);
+    if (m_width == 0 || m_height == 0)
+        return mask;
+
+    for (int y = 0; y < mask.m_height; ++y) {
+        const int sy = (qint64)y * m_height / mask.m_height;
+        if (y > 0 && sy == (qint64)(y - 1) * m_height / mask.m_height) {
+            mask.m_lines[y] = mask.m_lines.at(y - 1);
+            continue;
+        }
+        const QVector<int>& src = m_lines.at(sy);
+        QVector<int>& line = mask.m_lines[y];
+        for (int i = 0; i < src.count(); i += 2) {
+            int start = (qint64)src.at(i) * mask.m_width / m_width;
+            int end = ((qint64)src.at(i + 1) * mask.m_width + m_width - 1) / m_width;
+            if (start >= end)
+                continue;
+            if (!line.isEmpty() && start <= line.last())
+                line.last() = qMax(line.last(), end);
+            else {
+                line.append(start);
+                line.append(end);
+            }
+        }
+    }
+    return mask;
+}
+
+SpanMask SpanMask::tiled(int width, int height) const
+{
+    SpanMask mask(width, height);
+    if (m_width == 0 || m_height == 0)
+        return mask;
+
+    /// repeat each source line horizontally once
+    QVector< QVector<int> > rows(m_height);
+    const int sh = qMin(m_height, mask.m_height);
+    for (int y = 0; y < sh; ++y) {
+        const QVector<int>& src = m_lines.at(y);
+        QVector<int>& line = rows[y];
+        for (int x = 0; x < mask.m_width; x += m_width) {
+            for (int i = 0; i < src.count(); i += 2) {
+                int start = x + src.at(i);
+                if (start >= mask.m_width)
+                    break;
+                int end = qMin(x + src.at(i + 1), mask.m_width);
+                if (!line.isEmpty() && start <= line.last())
+                    line.last() = qMax(line.last(), end);
+                else {
+                    line.append(start);
+                    line.append(end);
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < mask.m_height; ++y) {
+        mask.m_lines[y] = rows.at(y % m_height);
+    }
+    return mask;
+}
+
+void SpanMask::unite(const SpanMask& other, int dx, int dy)
+{
+    const int y0 = qMax(0, dy);
+    const int y1 = qMin(m_height, dy + other.m_height);
+    for (int y = y0; y < y1; ++y) {
+        const QVector<int>& src = other.m_lines.at(y - dy);
+        if (src.isEmpty())
+            continue;
+
+        QVector<int> placed;
+        placed.reserve(src.count());
+        for (int i = 0; i < src.count(); i += 2) {
+            int start = qMax(src.at(i) + dx, 0);
+            int end = qMin(src.at(i + 1) + dx, m_width);
+            if (start < end) {
+                placed.append(start);
+                placed.append(end);
+            }
+        }
+        m_lines[y] = mergeSpans(m_lines.at(y), placed);
+    }
+}
+
+QRegion SpanMask::toRegion() const
+{
+    /// identical neighbouring lines form one band
+    QVector<QRect> rects;
+    int y = 0;
+    while (y < m_height) {
+        const QVector<int>& line = m_lines.at(y);
+        int y2 = y + 1;
+        while (y2 < m_height && m_lines.at(y2) == line)
+            ++y2;
+        for (int i = 0; i < line.count(); i += 2) {
+            rects.append(QRect(line.at(i), y, line.at(i + 1) - line.at(i), y2 - y));
+        }
+        y = y2;
+    }
+
+    QRegion region;
+    if (!rects.isEmpty())
+        region.setRects(rects.constData(), rects.count());
+    return region;
+}
+
+bool SpanMask::operator==(const SpanMask& other) const
+{
+    return m_width == other.m_width && m_height == other.m_height && m_lines == other.m_lines;
+}
@@ -0,0 +1,68 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPANMASK_H
+#define SPANMASK_H
+
+#include <QRegion>
+#include <QVector>
+
+class QImage;
+class QPixmap;
+
+/**
+ * Window shape as per-scanline runs of opaque pixels.
+ *
+ * Each scanline holds sorted, non-touching [start, end) pairs. Scaling,
+ * tiling and placing are done on the runs directly, and only the final
+ * composition is turned into a QRegion.
+ */
+class SpanMask
+{
+public:
+    explicit SpanMask();
+    explicit SpanMask(int width, int height);
+    static SpanMask fromImage(const QImage& image);
+    static SpanMask fromPixmap(const QPixmap& pixmap);
+    int width() const {
+        return m_width;
+    }
+    int height() const {
+        return m_height;
+    }
+    bool isEmpty() const;
+    /// nearest neighbour scaling to width x height
+    SpanMask scaled(int width, int height) const;
+    /// repeat the mask to fill width x height
+    SpanMask tiled(int width, int height) const;
+    /// union other placed at (dx, dy), clipped to this mask
+    void unite(const SpanMask& other, int dx, int dy);
+    QRegion toRegion() const;
+    bool operator==(const SpanMask& other) const;
+    bool operator!=(const SpanMask& other) const {
+        return !operator==(other);
+    }
+private:
+    int m_width, m_height;
+    QVector< QVector<int> > m_lines;
+};
+
+#endif // SPANMASK_H
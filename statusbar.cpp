@@ -22,7 +22,6 @@
 #include "statusbar.h"
 
 #include <QAction>
-#include <QDBusConnection>
 #include <QDebug>
 #include <QIcon>
 #include <QMenu>
@@ -45,6 +44,7 @@
 #include "animator.h"
 #include "filtermenu.h"
 #include "impanelagent.h"
+#include "impanelrelay.h"
 #include "propertywidget.h"
 #include "preeditbar.h"
 #include "statusbarlayout.h"
@@ -135,20 +135,18 @@ StatusBar::StatusBar()
     m_visibleDelayer.setSingleShot(true);
     connect(&m_visibleDelayer, SIGNAL(timeout()), this, SLOT(slotSetVisibleDelayed()));
 
-    slotConnectKIMPanel();
-
     KConfigGroup group(KSharedConfig::openConfig(), "General");
     QPoint pos = group.readEntry("XYPosition", QPoint(100, 0));
     move(pos);
 
     m_filters = group.readEntry("Filters", QStringList());
 
-    connect(Animator::self(), SIGNAL(animateStatusBar()), this, SLOT(update()));
-    connect(Animator::self(), SIGNAL(animatePreEditBar()), m_preeditBar, SLOT(update()));
+    connect(Animator::self(), SIGNAL(animateStatusBar(QRect)), this, SLOT(slotAnimate(QRect)));
+    connect(Animator::self(), SIGNAL(animatePreEditBar(QRect)), m_preeditBar, SLOT(slotAnimate(QRect)));
 
     loadSettings();
 
-    IMPanelAgent::PanelCreated();
+    slotConnectKIMPanel();
 
     m_visibleDelayer.start(100);
 }
@@ -437,6 +435,14 @@ void StatusBar::slotExecMenu(const QStringList& actions)
     menu->grabMouse();
 }
 
+void StatusBar::slotAnimate(const QRect& rect)
+{
+    if (rect.isNull())
+        update();
+    else
+        update(rect);
+}
+
 void StatusBar::slotAutostartToggled(bool enable)
 {
     KIMToySettings::self()->setAutostartKIMToy(enable);
@@ -541,6 +547,7 @@ void StatusBar::loadSettings()
 
     updateSize();
     m_preeditBar->resize(ThemerAgent::sizeHintPreEditBar(m_preeditBar));
+    m_preeditBar->prewarm();
 }
 
 void StatusBar::slotFilterChanged(const QString& objectPath, bool checked)
@@ -567,36 +574,23 @@ void StatusBar::slotFilterMenuDestroyed()
 
 void StatusBar::slotConnectKIMPanel()
 {
-    QDBusConnection connection = QDBusConnection::sessionBus();
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "Enable",
-                       this, SLOT(slotEnable(bool)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "RegisterProperties",
-                       this, SLOT(slotRegisterProperties(const QStringList&)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateProperty",
-                       this, SLOT(slotUpdateProperty(const QString&)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "RemoveProperty",
-                       this, SLOT(slotRemoveProperty(const QString&)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ExecDialog",
-                       this, SLOT(slotExecDialog(const QString&)));
-    connection.connect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ExecMenu",
-                       this, SLOT(slotExecMenu(const QStringList&)));
+    IMPanelRelay* relay = IMPanelRelay::self();
+    connect(relay, SIGNAL(Enable(bool)), this, SLOT(slotEnable(bool)), Qt::UniqueConnection);
+    connect(relay, SIGNAL(RegisterProperties(QStringList)),
+            this, SLOT(slotRegisterProperties(QStringList)), Qt::UniqueConnection);
+    connect(relay, SIGNAL(UpdateProperty(QString)), this, SLOT(slotUpdateProperty(QString)), Qt::UniqueConnection);
+    connect(relay, SIGNAL(RemoveProperty(QString)), this, SLOT(slotRemoveProperty(QString)), Qt::UniqueConnection);
+    connect(relay, SIGNAL(ExecDialog(QString)), this, SLOT(slotExecDialog(QString)), Qt::UniqueConnection);
+    connect(relay, SIGNAL(ExecMenu(QStringList)), this, SLOT(slotExecMenu(QStringList)), Qt::UniqueConnection);
+
+    /// signals sent while disconnected are lost, ask the bridges to send everything again
+    IMPanelAgent::PanelCreated();
 }
 
 void StatusBar::slotDisconnectKIMPanel()
 {
-    QDBusConnection connection = QDBusConnection::sessionBus();
-    connection.disconnect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "Enable",
-                          this, SLOT(slotEnable(bool)));
-    connection.disconnect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "RegisterProperties",
-                          this, SLOT(slotRegisterProperties(const QStringList&)));
-    connection.disconnect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "UpdateProperty",
-                          this, SLOT(slotUpdateProperty(const QString&)));
-    connection.disconnect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "RemoveProperty",
-                          this, SLOT(slotRemoveProperty(const QString&)));
-    connection.disconnect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ExecDialog",
-                          this, SLOT(slotExecDialog(const QString&)));
-    connection.disconnect("", "/kimpanel", "org.kde.kimpanel.inputmethod", "ExecMenu",
-                          this, SLOT(slotExecMenu(const QStringList&)));
+    /// the bus match rules stay with the relay, only the local links are dropped
+    IMPanelRelay::self()->disconnect(this);
 }
 
 void StatusBar::updateSize()
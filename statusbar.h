@@ -59,6 +59,7 @@ private Q_SLOTS:
     void slotRemoveProperty(const QString& prop);
     void slotExecDialog(const QString& prop);
     void slotExecMenu(const QStringList& actions);
+    void slotAnimate(const QRect& rect);
 private Q_SLOTS:
     void slotAutostartToggled(bool enable);
     void slotTrayiconModeToggled(bool enable);
@@ -26,6 +26,8 @@
 #include <KMessageBox>
 #include <KNS3/DownloadDialog>
 
+#include "compiledskin.h"
+
 #include "kimtoysettings.h"
 
 void ThemeWidget::installTheme()
@@ -35,7 +37,7 @@ void ThemeWidget::installTheme()
     if (filePath.isEmpty())
         return;
 
-    if (!filePath.endsWith(".ssf") && !filePath.endsWith(".fskin")) {
+    if (!filePath.endsWith(".ssf") && !filePath.endsWith(".fskin") && !filePath.endsWith(COMPILEDSKIN_SUFFIX)) {
         KMessageBox::error(this, i18n("Unsupported theme type."));
         return;
     }
@@ -0,0 +1,239 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "themecache.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <KCompressionDevice>
+
+static const char CACHE_MAGIC[] = "KIMTOYC2";
+
+/// total size of all entries, the oldest ones are pruned above it
+static const qint64 CACHE_SIZE_LIMIT = 256 * 1024 * 1024;
+
+static bool s_storeEnabled = false;
+
+/// magic, source size, source mtime, payload size, source path
+struct CacheHeader {
+    qint64 sourceSize;
+    qint64 sourceMtime;
+    qint64 payloadSize;
+    QString sourcePath;
+    /// offset of the payload
+    qint64 size;
+};
+
+/// keeps the cache file mapped for as long as the buffer lives
+class MappedCacheBuffer : public QBuffer
+{
+public:
+    explicit MappedCacheBuffer(QFile* file, uchar* data, qint64 size)
+            : m_file(file), m_data(data)
+    {
+        setData(QByteArray::fromRawData((const char*)data, size));
+    }
+    virtual ~MappedCacheBuffer()
+    {
+        close();
+        setData(QByteArray());
+        m_file->unmap(m_data);
+        delete m_file;
+    }
+private:
+    QFile* m_file;
+    uchar* m_data;
+};
+
+static QString cacheDirPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/kimtoy/themes/";
+}
+
+static QString cacheFilePath(const QFileInfo& info)
+{
+    QByteArray key = info.canonicalFilePath().toUtf8();
+    QString name = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return cacheDirPath() + name + ".cache";
+}
+
+static bool readHeader(QFile* file, CacheHeader& header)
+{
+    QDataStream ds(file);
+    QByteArray magic(8, '\0');
+    ds.readRawData(magic.data(), 8);
+    if (magic != CACHE_MAGIC)
+        return false;
+
+    QByteArray sourcePath;
+    ds >> header.sourceSize >> header.sourceMtime >> header.payloadSize >> sourcePath;
+
+    header.sourcePath = QString::fromUtf8(sourcePath);
+    header.size = file->pos();
+    return ds.status() == QDataStream::Ok
+           && header.payloadSize > 0
+           && file->size() == header.size + header.payloadSize;
+}
+
+/// drop entries of removed themes, then the oldest ones until the cache fits
+static void prune()
+{
+    QDir dir(cacheDirPath());
+    /// newest first, whatever no longer fits is the oldest
+    QFileInfoList entries = dir.entryInfoList(QStringList() << "*.cache", QDir::Files, QDir::Time);
+
+    qint64 total = 0;
+    foreach (const QFileInfo& entry, entries) {
+        QFile file(entry.absoluteFilePath());
+        CacheHeader header;
+        bool keep = file.open(QIODevice::ReadOnly) && readHeader(&file, header)
+                    && QFile::exists(header.sourcePath)
+                    && total + entry.size() <= CACHE_SIZE_LIMIT;
+        file.close();
+
+        if (keep)
+            total += entry.size();
+        else
+            QFile::remove(entry.absoluteFilePath());
+    }
+}
+
+namespace ThemeCache
+{
+
+QIODevice* open(const QFileInfo& info)
+{
+    QFile* file = new QFile(cacheFilePath(info));
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return 0;
+    }
+
+    CacheHeader header;
+    if (!readHeader(file, header)
+        || header.sourceSize != info.size()
+        || header.sourceMtime != info.lastModified().toMSecsSinceEpoch()) {
+        delete file;
+        return 0;
+    }
+
+    uchar* data = file->map(header.size, header.payloadSize);
+    if (!data) {
+        delete file;
+        return 0;
+    }
+
+    QIODevice* dev = new MappedCacheBuffer(file, data, header.payloadSize);
+    dev->open(QIODevice::ReadOnly);
+    return dev;
+}
+
+void setStoreEnabled(bool enabled)
+{
+    s_storeEnabled = enabled;
+}
+
+void store(const QFileInfo& info, const QByteArray& data)
+{
+    if (!s_storeEnabled || data.size() > CACHE_SIZE_LIMIT)
+        return;
+
+    QString path = cacheFilePath(info);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    /// written aside and renamed over, concurrent readers never see a partial entry
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream ds(&file);
+    ds.writeRawData(CACHE_MAGIC, 8);
+    ds << (qint64)info.size() << (qint64)info.lastModified().toMSecsSinceEpoch() << (qint64)data.size()
+       << info.canonicalFilePath().toUtf8();
+    ds.writeRawData(data.constData(), data.size());
+
+    if (ds.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "failed to write theme cache" << path;
+        return;
+    }
+
+    prune();
+}
+
+QIODevice* openTar(const QString& file)
+{
+    QFileInfo info(file);
+    QIODevice* cached = open(info);
+    if (cached)
+        return cached;
+
+    /// sniff the compression, fskin files carry no telling suffix
+    QFile raw(file);
+    if (!raw.open(QIODevice::ReadOnly))
+        return 0;
+    QByteArray magic = raw.peek(6);
+    raw.close();
+
+    KCompressionDevice::CompressionType type = KCompressionDevice::None;
+    if (magic.startsWith("\x1f\x8b"))
+        type = KCompressionDevice::GZip;
+    else if (magic.startsWith("BZh"))
+        type = KCompressionDevice::BZip2;
+    else if (magic.startsWith("\xfd" "7zXZ"))
+        type = KCompressionDevice::Xz;
+
+    QByteArray data;
+    if (type == KCompressionDevice::None) {
+        if (!raw.open(QIODevice::ReadOnly))
+            return 0;
+        data = raw.readAll();
+    }
+    else {
+        KCompressionDevice dev(file, type);
+        if (!dev.open(QIODevice::ReadOnly))
+            return 0;
+        data = dev.readAll();
+    }
+
+    if (data.isEmpty())
+        return 0;
+
+    /// plain tars are read in place and not worth caching
+    if (type != KCompressionDevice::None)
+        store(info, data);
+
+    QBuffer* buffer = new QBuffer;
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+}
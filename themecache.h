@@ -0,0 +1,55 @@
+/*
+ *  This file is part of KIMToy, an input method frontend for KDE
+ *  Copyright (C) 2011-2016 Ni Hui <shuizhuyuanluo@126.com>
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THEMECACHE_H
+#define THEMECACHE_H
+
+class QByteArray;
+class QFileInfo;
+class QIODevice;
+class QString;
+
+/**
+ * On-disk cache of decoded theme archives
+ *
+ * Entries live under the generic cache location so that kimtoy, the
+ * thumbnailers and the metadata extractors share them. An entry is named
+ * after the hash of the canonical theme path and is valid while the
+ * theme size and modification time match. Entries are replaced
+ * atomically, readers keep their mapping of the old file.
+ *
+ * Only processes that enable storing write entries, the others just read
+ * them. Each store prunes entries of removed themes and then the oldest
+ * entries above the size limit.
+ */
+namespace ThemeCache
+{
+/// read only device mapping the cached archive of info, 0 on a miss
+QIODevice* open(const QFileInfo& info);
+/// allow store to write entries, off by default
+void setStoreEnabled(bool enabled);
+/// cache the decoded archive of info, stamped with the size and mtime in info
+void store(const QFileInfo& info, const QByteArray& data);
+/// uncompressed tar of a fskin theme, decompressed and cached on a miss if storing is enabled
+QIODevice* openTar(const QString& file);
+}
+
+#endif // THEMECACHE_H
@@ -35,6 +35,8 @@
 #include <Plasma/FrameSvg>
 #include <Plasma/Theme>
 
+#include "compiledskin.h"
+
 #include "kimtoysettings.h"
 
 ThemeListModel::ThemeListModel(QObject* parent)
@@ -163,7 +165,7 @@ void ThemeListModel::loadFileThemes()
     QString themeFolder = KIMToySettings::self()->themeFolder().path();
 //     kWarning() << themeFolder;
     QDir dir(themeFolder);
-    QFileInfoList es = dir.entryInfoList(QStringList() << "*.fskin" << "*.ssf");
+    QFileInfoList es = dir.entryInfoList(QStringList() << "*.fskin" << "*.ssf" << "*" COMPILEDSKIN_SUFFIX);
 
     // load downloaded themes
     QString knsFolder = QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/themes/";
@@ -171,7 +173,7 @@ void ThemeListModel::loadFileThemes()
 //     kWarning() << knsFolder;
     if (knsFolder != themeFolder) {
         QDir knsThemeDir(knsFolder);
-        es << knsThemeDir.entryInfoList(QStringList() << "*.fskin" << "*.ssf");
+        es << knsThemeDir.entryInfoList(QStringList() << "*.fskin" << "*.ssf" << "*" COMPILEDSKIN_SUFFIX);
     }
 
     KFileItemList items;
@@ -21,6 +21,9 @@
 
 #include "themer.h"
 
+#include <QFontMetrics>
+#include <QPainter>
+
 #include <KWindowEffects>
 
 #include "preeditbar.h"
@@ -28,8 +31,22 @@
 
 #include "kimtoysettings.h"
 
+struct ColorizedLayerCache
+{
+    QSize size;
+    qint64 skinKey;
+    qint64 maskKey;
+    QRgb color;
+    QPixmap pixmap;
+};
+
+/// shared by all themers, index by Themer::ColorizedLayer
+static ColorizedLayerCache* colorizedLayers = 0;
+
 Themer::Themer()
 {
+    m_layoutWidget = 0;
+    m_layoutRevision = 0;
 }
 
 Themer::~Themer()
@@ -38,6 +55,9 @@ Themer::~Themer()
 
 void Themer::loadSettings()
 {
+    /// fonts may change
+    m_layoutWidget = 0;
+
     if (KIMToySettings::self()->useCustomFont()) {
         m_preEditFont = KIMToySettings::self()->preeditFont();
         m_labelFont = KIMToySettings::self()->labelFont();
@@ -72,10 +92,117 @@ void Themer::resizeStatusBar(const QSize& size)
 
 void Themer::blurPreEditBar(PreEditBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, widget->mask());
+    applyBlurBehind(widget, widget->mask());
 }
 
 void Themer::blurStatusBar(StatusBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, widget->mask());
+    applyBlurBehind(widget, widget->mask());
+}
+
+void Themer::applyMask(QWidget* widget, const QRegion& region)
+{
+    if (widget->mask() == region)
+        return;
+
+    /// qt sends the banded rectangles of the region as one shape request
+    widget->setMask(region);
+}
+
+void Themer::applyBlurBehind(QWidget* widget, const QRegion& region)
+{
+    /// remembered on the widget itself, a new native window needs it again
+    const QVariant appliedWinId = widget->property("_kimtoy_blur_winid");
+    const QVariant appliedRegion = widget->property("_kimtoy_blur_region");
+    if (appliedWinId.isValid() && appliedWinId.value<WId>() == widget->winId()
+        && appliedRegion.value<QRegion>() == region)
+        return;
+
+    KWindowEffects::enableBlurBehind(widget->winId(), true, region);
+    widget->setProperty("_kimtoy_blur_winid", QVariant::fromValue(widget->winId()));
+    widget->setProperty("_kimtoy_blur_region", region);
+}
+
+QRect Themer::preEditCaretRect(const PreEditBar* widget) const
+{
+    return widget->rect();
+}
+
+QRect Themer::candidateRect(const PreEditBar* widget, int index) const
+{
+    Q_UNUSED(index);
+    return widget->rect();
+}
+
+const PreEditLayout& Themer::preEditLayout(const PreEditBar* widget) const
+{
+    bool vertical = KIMToySettings::self()->verticalPreeditBar();
+    if (widget != m_layoutWidget || widget->m_revision != m_layoutRevision || vertical != m_preEditLayout.vertical) {
+        m_preEditLayout.layout(widget->m_text + widget->m_auxText, widget->m_labels, widget->m_candidates,
+                               m_preEditFont, m_labelFont, m_candidateFont, vertical);
+        m_layoutWidget = widget;
+        m_layoutRevision = widget->m_revision;
+    }
+    return m_preEditLayout;
+}
+
+QRect Themer::caretRect(const PreEditBar* widget, const QPoint& origin) const
+{
+    int pixelsWide = QFontMetrics(m_preEditFont).width(widget->m_text.left(widget->m_cursorPos));
+    /// one pixel of slack on each side of the caret line
+    return QRect(origin.x() + pixelsWide - 1, origin.y(), 3, m_preEditFontHeight + 1);
+}
+
+QRect Themer::candidateCellRect(const PreEditBar* widget, int index, const QPoint& origin) const
+{
+    return preEditLayout(widget).cellRect(index).translated(origin);
+}
+
+void Themer::drawLookupTable(QPainter* p, const PreEditBar* widget, const QPoint& origin) const
+{
+    const PreEditLayout& layout = preEditLayout(widget);
+    int count = layout.count();
+    for (int i = 0; i < count; ++i) {
+        /// draw label
+        p->setFont(m_labelFont);
+        p->setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
+        p->drawStaticText(origin + layout.labelRects.at(i).topLeft() + QPoint(0, layout.labelOffset), layout.labelStaticTexts.at(i));
+        /// draw candidate
+        p->setFont(m_candidateFont);
+        p->setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
+        p->drawStaticText(origin + layout.candidateRects.at(i).topLeft() + QPoint(0, layout.candidateOffset), layout.candidateStaticTexts.at(i));
+    }
+}
+
+void Themer::clearColorizedLayers()
+{
+    delete[] colorizedLayers;
+    colorizedLayers = 0;
+}
+
+void Themer::drawColorizedLayer(QPainter* p, ColorizedLayer layer, const QSize& size,
+                                const QPixmap& skin, const QPixmap& mask, const QColor& color)
+{
+    if (!colorizedLayers)
+        colorizedLayers = new ColorizedLayerCache[2];
+
+    ColorizedLayerCache& c = colorizedLayers[layer];
+    if (c.pixmap.isNull() || c.size != size || c.skinKey != skin.cacheKey()
+            || c.maskKey != mask.cacheKey() || c.color != color.rgba()) {
+        c.size = size;
+        c.skinKey = skin.cacheKey();
+        c.maskKey = mask.cacheKey();
+        c.color = color.rgba();
+        c.pixmap = QPixmap(size);
+        c.pixmap.fill(Qt::transparent);
+
+        QPainter p2(&c.pixmap);
+        p2.drawPixmap(0, 0, mask);
+        p2.setCompositionMode(QPainter::CompositionMode_SourceIn);
+        p2.fillRect(c.pixmap.rect(), color);
+        p2.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        p2.drawPixmap(0, 0, skin);
+    }
+
+    p->drawPixmap(0, 0, c.pixmap);
 }
@@ -27,6 +27,10 @@
 #include <QPixmap>
 #include <QRegion>
 
+#include "preeditlayout.h"
+
+class QPainter;
+class QWidget;
 class PreEditBar;
 class PropertyWidget;
 class StatusBar;
@@ -62,7 +66,33 @@ public:
     virtual void drawStatusBar(StatusBar* widget) = 0;
     virtual void drawPropertyWidget(PropertyWidget* widget) = 0;
 
+    /// area touched by the preedit caret, the whole widget by default
+    virtual QRect preEditCaretRect(const PreEditBar* widget) const;
+    /// area of the label and candidate at index, the whole widget by default
+    virtual QRect candidateRect(const PreEditBar* widget, int index) const;
+
+    static void clearColorizedLayers();
+
 protected:
+    enum ColorizedLayer { PreEditBarLayer = 0, StatusBarLayer = 1 };
+    /// draw skin over color clipped to mask, the composed layer is cached until size, skin or color changes
+    static void drawColorizedLayer(QPainter* p, ColorizedLayer layer, const QSize& size,
+                                   const QPixmap& skin, const QPixmap& mask, const QColor& color);
+
+    /// set the shape mask, skipped if the widget already has this region
+    static void applyMask(QWidget* widget, const QRegion& region);
+    /// set the blur behind region, skipped if it was last set to this region on the same window
+    static void applyBlurBehind(QWidget* widget, const QRegion& region);
+
+    /// measured preedit bar content, recomputed only when it changed
+    const PreEditLayout& preEditLayout(const PreEditBar* widget) const;
+    /// caret of preedit text drawn at origin
+    QRect caretRect(const PreEditBar* widget, const QPoint& origin) const;
+    /// candidate cell of lookup table drawn at origin, empty if index is out of range
+    QRect candidateCellRect(const PreEditBar* widget, int index, const QPoint& origin) const;
+    /// draw labels and candidates of lookup table at origin
+    void drawLookupTable(QPainter* p, const PreEditBar* widget, const QPoint& origin) const;
+
     QFont m_preEditFont;
     QFont m_labelFont;
     QFont m_candidateFont;
@@ -73,6 +103,10 @@ protected:
     QColor m_labelColor;
     QColor m_candidateColor;
     QColor m_candidateCursorColor;
+private:
+    mutable PreEditLayout m_preEditLayout;
+    mutable const PreEditBar* m_layoutWidget;
+    mutable int m_layoutRevision;
 };
 
 #endif // THEMER_H
@@ -27,17 +27,17 @@
 #include <QFontMetrics>
 #include <QPainter>
 #include <QPixmap>
+#include <QScopedPointer>
 #include <QString>
 #include <QTextStream>
 
 #include <KIconLoader>
-#include <KTar>
-#include <KWindowEffects>
 
 #include "preeditbar.h"
 #include "statusbar.h"
 #include "statusbarlayout.h"
 #include "propertywidget.h"
+#include "skinsource.h"
 
 #include "kimtoysettings.h"
 
@@ -79,25 +79,11 @@ bool ThemerFcitx::loadTheme()
     if (!QFile::exists(file))
         return false;
 
-    KTar tar(file);
-    if (!tar.open(QIODevice::ReadOnly))
+    QScopedPointer<SkinSource> source(SkinSource::open(file));
+    if (!source || !source->contains("fcitx_skin.conf"))
         return false;
 
-    QStringList entries = tar.directory()->entries();
-    if (entries.count() != 1)
-        return false;
-
-    const KArchiveEntry* entry = tar.directory()->entry(entries.first());
-    if (!entry->isDirectory())
-        return false;
-
-    const KArchiveDirectory* subdir = static_cast<const KArchiveDirectory*>(entry);
-    const KArchiveEntry* skinconf_entry = subdir->entry("fcitx_skin.conf");
-    const KArchiveFile* skinconf = static_cast<const KArchiveFile*>(skinconf_entry);
-    if (!skinconf)
-        return false;
-
-    QByteArray data = skinconf->data();
+    QByteArray data = source->data("fcitx_skin.conf");
 
     /// parse ini file content
     bool skinfont = false;
@@ -121,15 +107,8 @@ bool ThemerFcitx::loadTheme()
 
 #define LOAD_PWPIX(p, value) \
     do { \
-        const KArchiveEntry* e = subdir->entry(value); \
-        QString symLinkTarget = e->symLinkTarget(); \
-        if (!symLinkTarget.isEmpty()) \
-            e = subdir->entry(symLinkTarget); \
-        const KArchiveFile* pix = static_cast<const KArchiveFile*>(e); \
-        if (pix) { \
-            QPixmap& pwpix = m_pwpix[ p ]; \
-            pwpix.loadFromData(pix->data()); \
-        } \
+        if (source->contains(value)) \
+            m_pwpix[ p ] = source->pixmap(value); \
     } while(0);
 
     QTextStream ss(data);
@@ -182,13 +161,7 @@ bool ThemerFcitx::loadTheme()
         }
         else if (skinmainbar) {
             if (key == "BackImg") {
-                const KArchiveEntry* e = subdir->entry(value);
-                QString symLinkTarget = e->symLinkTarget();
-                if (!symLinkTarget.isEmpty())
-                    e = subdir->entry(symLinkTarget);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix)
-                    statusBarPixmap.loadFromData(pix->data());
+                statusBarPixmap = source->pixmap(value);
             }
             else if (key == "MarginLeft") {
                 sml = value.toInt();
@@ -249,13 +222,7 @@ bool ThemerFcitx::loadTheme()
         }
         else if (skininputbar) {
             if (key == "BackImg") {
-                const KArchiveEntry* e = subdir->entry(value);
-                QString symLinkTarget = e->symLinkTarget();
-                if (!symLinkTarget.isEmpty())
-                    e = subdir->entry(symLinkTarget);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix)
-                    preEditBarPixmap.loadFromData(pix->data());
+                preEditBarPixmap = source->pixmap(value);
             }
             else if (key == "Resize") {
                 resizemode = value;
@@ -282,22 +249,10 @@ bool ThemerFcitx::loadTheme()
                 color_cursor = value2color(value);
             }
             else if (key == "BackArrow") {
-                const KArchiveEntry* e = subdir->entry(value);
-                QString symLinkTarget = e->symLinkTarget();
-                if (!symLinkTarget.isEmpty())
-                    e = subdir->entry(symLinkTarget);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix)
-                    barrow.loadFromData(pix->data());
+                barrow = source->pixmap(value);
             }
             else if (key == "ForwardArrow") {
-                const KArchiveEntry* e = subdir->entry(value);
-                QString symLinkTarget = e->symLinkTarget();
-                if (!symLinkTarget.isEmpty())
-                    e = subdir->entry(symLinkTarget);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix)
-                    farrow.loadFromData(pix->data());
+                farrow = source->pixmap(value);
             }
             else if (key == "BackArrowX") {
                 xba = value.toInt();
@@ -357,33 +312,17 @@ bool ThemerFcitx::loadTheme()
 
 QSize ThemerFcitx::sizeHintPreEditBar(const PreEditBar* widget) const
 {
+    const PreEditLayout& layout = preEditLayout(widget);
     int w = preEditBarSkin.skinw();
     int h = preEditBarSkin.skinh();
 
     /// preedit and aux
-    int pinyinauxw = QFontMetrics(m_preEditFont).width(widget->m_text + widget->m_auxText);
-    w = qMax(pinyinauxw + ml + mr, w);
+    w = qMax(layout.preEditWidth + ml + mr, w);
 
-    int candidateh = mt + ych - m_candidateFontHeight + mb;
     /// lookuptable
-    if (KIMToySettings::self()->verticalPreeditBar()) {
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-        for (int i = 0; i < count; ++i) {
-            QString tmp = widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed();
-            w = qMax(QFontMetrics(m_candidateFont).width(tmp) + ml + mr, w);
-            candidateh += m_candidateFontHeight;
-        }
-    }
-    else {
-        QString tmp;
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-        for (int i = 0; i < count; ++i) {
-            tmp += widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed() + ' ';
-        }
-        int lookuptablew = QFontMetrics(m_candidateFont).width(tmp);
-        w = qMax(lookuptablew + ml + mr, w);
-        candidateh += m_candidateFontHeight;
-    }
+    QSize lookuptableSize = layout.lookupTableSize();
+    w = qMax(lookuptableSize.width() + ml + mr, w);
+    int candidateh = mt + ych - m_candidateFontHeight + mb + lookuptableSize.height();
     h = qMax(candidateh, h);
 
     if (!KIMToySettings::self()->enablePreeditResizing()) {
@@ -489,7 +428,7 @@ void ThemerFcitx::resizeStatusBar(const QSize& size)
 
 void ThemerFcitx::maskPreEditBar(PreEditBar* widget)
 {
-    widget->setMask(preEditBarSkin.currentRegion());
+    applyMask(widget, preEditBarSkin.currentRegion());
 }
 
 void ThemerFcitx::maskStatusBar(StatusBar* widget)
@@ -498,27 +437,27 @@ void ThemerFcitx::maskStatusBar(StatusBar* widget)
     foreach(const QLayoutItem* item, widget->m_layout->m_items) {
         mask |= item->geometry();
     }
-    widget->setMask(mask);
+    applyMask(widget, mask);
 }
 
 void ThemerFcitx::maskPropertyWidget(PropertyWidget* widget)
 {
     if (m_pwpix.contains(widget->type()))
-        widget->setMask(m_pwpix.value(widget->type()).mask());
+        applyMask(widget, m_pwpix.value(widget->type()).mask());
     else if (!widget->iconName().isEmpty())
-        widget->setMask(MainBarIcon(widget->iconName()).mask());
+        applyMask(widget, MainBarIcon(widget->iconName()).mask());
     else
-        widget->clearMask();
+        applyMask(widget, QRegion());
 }
 
 void ThemerFcitx::blurPreEditBar(PreEditBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, preEditBarSkin.currentRegion());
+    applyBlurBehind(widget, preEditBarSkin.currentRegion());
 }
 
 void ThemerFcitx::blurStatusBar(StatusBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, statusBarSkin.currentRegion());
+    applyBlurBehind(widget, statusBarSkin.currentRegion());
 }
 
 void ThemerFcitx::drawPreEditBar(PreEditBar* widget)
@@ -526,17 +465,9 @@ void ThemerFcitx::drawPreEditBar(PreEditBar* widget)
     QPainter p(widget);
 
     if (KIMToySettings::self()->backgroundColorizing()) {
-        QImage renderedSkin(widget->size(), QImage::Format_ARGB32_Premultiplied);
-        renderedSkin.fill(Qt::transparent);
-        QPainter p2(&renderedSkin);
-        preEditBarSkin.drawPixmap(&p2, widget->width(), widget->height());
-
-        p.save();
-        p.fillRect(widget->rect(), KIMToySettings::self()->preeditBarColorize());
-        p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-        p.drawImage(0, 0, renderedSkin);
-        p.restore();
-        p.drawImage(0, 0, renderedSkin);
+        const QPixmap skin = preEditBarSkin.pixmap(widget->size());
+        drawColorizedLayer(&p, PreEditBarLayer, widget->size(), skin, skin,
+                           KIMToySettings::self()->preeditBarColorize());
     }
     else
         preEditBarSkin.drawPixmap(&p, widget->width(), widget->height());
@@ -550,7 +481,11 @@ void ThemerFcitx::drawPreEditBar(PreEditBar* widget)
         p.setFont(m_preEditFont);
         p.setPen(m_preEditColor);
 
-        p.drawText(ml, pinyiny, widget->width() - ml - mr, m_preEditFontHeight, Qt::AlignLeft, widget->m_text + widget->m_auxText);
+        /// keep long preedit inside the margins
+        p.save();
+        p.setClipRect(ml, pinyiny, widget->width() - ml - mr, m_preEditFontHeight, Qt::IntersectClip);
+        p.drawStaticText(ml, pinyiny, preEditLayout(widget).preEditStaticText);
+        p.restore();
         if (widget->preeditVisible) {
             int pixelsWide = QFontMetrics(m_preEditFont).width(widget->m_text.left(widget->m_cursorPos));
             p.drawLine(ml + pixelsWide, pinyiny, ml + pixelsWide, pinyiny + m_preEditFontHeight);
@@ -560,46 +495,7 @@ void ThemerFcitx::drawPreEditBar(PreEditBar* widget)
 
     if (widget->lookuptableVisible) {
         /// draw lookup table
-        int x = ml;
-        int w = 0;
-        int h = qMax(m_labelFontHeight, m_candidateFontHeight);
-
-        /// draw labels and candidates
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-
-        if (KIMToySettings::self()->verticalPreeditBar()) {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                x = ml;
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, zhongweny, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed());
-                p.drawText(x, zhongweny, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed());
-                zhongweny += h;
-            }
-        }
-        else {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, zhongweny, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed() + ' ');
-                p.drawText(x, zhongweny, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed() + ' ');
-                x += w;
-            }
-        }
+        drawLookupTable(&p, widget, QPoint(ml, zhongweny));
     }
 }
 
@@ -608,17 +504,9 @@ void ThemerFcitx::drawStatusBar(StatusBar* widget)
     QPainter p(widget);
 
     if (KIMToySettings::self()->backgroundColorizing()) {
-        QImage renderedSkin(widget->size(), QImage::Format_ARGB32_Premultiplied);
-        renderedSkin.fill(Qt::transparent);
-        QPainter p2(&renderedSkin);
-        statusBarSkin.drawPixmap(&p2, widget->width(), widget->height());
-
-        p.save();
-        p.fillRect(widget->rect(), KIMToySettings::self()->statusBarColorize());
-        p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-        p.drawImage(0, 0, renderedSkin);
-        p.restore();
-        p.drawImage(0, 0, renderedSkin);
+        const QPixmap skin = statusBarSkin.pixmap(widget->size());
+        drawColorizedLayer(&p, StatusBarLayer, widget->size(), skin, skin,
+                           KIMToySettings::self()->statusBarColorize());
     }
     else
         statusBarSkin.drawPixmap(&p, widget->width(), widget->height());
@@ -636,3 +524,13 @@ void ThemerFcitx::drawPropertyWidget(PropertyWidget* widget)
         p.drawText(widget->rect(), Qt::AlignCenter, widget->name());
     }
 }
+
+QRect ThemerFcitx::preEditCaretRect(const PreEditBar* widget) const
+{
+    return caretRect(widget, QPoint(ml, mt + yen - m_preEditFontHeight));
+}
+
+QRect ThemerFcitx::candidateRect(const PreEditBar* widget, int index) const
+{
+    return candidateCellRect(widget, index, QPoint(ml, mt + ych - m_candidateFontHeight));
+}
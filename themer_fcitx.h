@@ -48,6 +48,8 @@ public:
     virtual void drawPreEditBar(PreEditBar* widget);
     virtual void drawStatusBar(StatusBar* widget);
     virtual void drawPropertyWidget(PropertyWidget* widget);
+    virtual QRect preEditCaretRect(const PreEditBar* widget) const;
+    virtual QRect candidateRect(const PreEditBar* widget, int index) const;
 private:
     SkinPixmap preEditBarSkin;
     SkinPixmap statusBarSkin;
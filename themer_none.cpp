@@ -70,37 +70,21 @@ bool ThemerNone::loadTheme()
 
 QSize ThemerNone::sizeHintPreEditBar(const PreEditBar* widget) const
 {
+    const PreEditLayout& layout = preEditLayout(widget);
     int w = 0;
     int h = 0;
 
     if (widget->preeditVisible || widget->auxVisible) {
         /// preedit and aux
-        int pinyinauxw = QFontMetrics(m_preEditFont).width(widget->m_text + widget->m_auxText);
-        w = qMax(pinyinauxw, w);
+        w = qMax(layout.preEditWidth, w);
         h += m_preEditFontHeight;
     }
 
     if (widget->lookuptableVisible) {
-        if (KIMToySettings::self()->verticalPreeditBar()) {
-            /// lookuptable
-            int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-            for (int i = 0; i < count; ++i) {
-                QString tmp = widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed();
-                w = qMax(QFontMetrics(m_candidateFont).width(tmp), w);
-                h += m_candidateFontHeight;
-            }
-        }
-        else {
-            /// lookuptable
-            QString tmp;
-            int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-            for (int i = 0; i < count; ++i) {
-                tmp += widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed() + ' ';
-            }
-            int lookuptablew = QFontMetrics(m_candidateFont).width(tmp);
-            w = qMax(lookuptablew, w);
-            h += m_candidateFontHeight;
-        }
+        /// lookuptable
+        QSize lookuptableSize = layout.lookupTableSize();
+        w = qMax(lookuptableSize.width(), w);
+        h += lookuptableSize.height();
     }
 
     if (!KIMToySettings::self()->enablePreeditResizing()) {
@@ -130,20 +114,20 @@ void ThemerNone::layoutStatusBar(StatusBarLayout* layout) const
 
 void ThemerNone::maskPreEditBar(PreEditBar* widget)
 {
-    widget->clearMask();
+    applyMask(widget, QRegion());
 }
 
 void ThemerNone::maskStatusBar(StatusBar* widget)
 {
-    widget->clearMask();
+    applyMask(widget, QRegion());
 }
 
 void ThemerNone::maskPropertyWidget(PropertyWidget* widget)
 {
     if (!widget->iconName().isEmpty())
-        widget->setMask(MainBarIcon(widget->iconName()).mask());
+        applyMask(widget, MainBarIcon(widget->iconName()).mask());
     else
-        widget->clearMask();
+        applyMask(widget, QRegion());
 }
 
 void ThemerNone::drawPreEditBar(PreEditBar* widget)
@@ -162,7 +146,10 @@ void ThemerNone::drawPreEditBar(PreEditBar* widget)
         p.setFont(m_preEditFont);
         p.setPen(m_preEditColor);
 
-        p.drawText(x, y, widget->width(), m_preEditFontHeight, Qt::AlignLeft, widget->m_text + widget->m_auxText);
+        p.save();
+        p.setClipRect(x, y, widget->width(), m_preEditFontHeight, Qt::IntersectClip);
+        p.drawStaticText(x, y, preEditLayout(widget).preEditStaticText);
+        p.restore();
         if (widget->preeditVisible) {
             int pixelsWide = QFontMetrics(m_preEditFont).width(widget->m_text.left(widget->m_cursorPos));
             p.drawLine(pixelsWide, 0, pixelsWide, m_preEditFontHeight);
@@ -172,45 +159,7 @@ void ThemerNone::drawPreEditBar(PreEditBar* widget)
 
     if (widget->lookuptableVisible) {
         /// draw lookup table
-        int w = 0;
-        int h = qMax(m_labelFontHeight, m_candidateFontHeight);
-
-        /// draw labels and candidates
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-
-        if (KIMToySettings::self()->verticalPreeditBar()) {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                x = 0;
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed());
-                y += h;
-            }
-        }
-        else {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed() + ' ');
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed() + ' ');
-                x += w;
-            }
-        }
+        drawLookupTable(&p, widget, QPoint(x, y));
     }
 }
 
@@ -230,3 +179,14 @@ void ThemerNone::drawPropertyWidget(PropertyWidget* widget)
     else
         p.drawText(widget->rect(), Qt::AlignCenter, widget->name());
 }
+
+QRect ThemerNone::preEditCaretRect(const PreEditBar* widget) const
+{
+    return caretRect(widget, QPoint(0, 0));
+}
+
+QRect ThemerNone::candidateRect(const PreEditBar* widget, int index) const
+{
+    int y = (widget->preeditVisible || widget->auxVisible) ? m_preEditFontHeight : 0;
+    return candidateCellRect(widget, index, QPoint(0, y));
+}
@@ -29,7 +29,6 @@
 
 #include <KIconLoader>
 #include <Plasma/Theme>
-#include <KWindowEffects>
 
 #include "preeditbar.h"
 #include "propertywidget.h"
@@ -88,13 +87,13 @@ bool ThemerPlasma::loadTheme()
 
 QSize ThemerPlasma::sizeHintPreEditBar(const PreEditBar* widget) const
 {
+    const PreEditLayout& layout = preEditLayout(widget);
     int w = 0;
     int h = 0;
 
     if (widget->preeditVisible || widget->auxVisible) {
         /// preedit and aux
-        int pinyinauxw = QFontMetrics(m_preEditFont).width(widget->m_text + widget->m_auxText);
-        w = qMax(pinyinauxw, w);
+        w = qMax(layout.preEditWidth, w);
         h += m_preEditFontHeight;
 
         /// spacing between preedit and lookuptable
@@ -103,24 +102,9 @@ QSize ThemerPlasma::sizeHintPreEditBar(const PreEditBar* widget) const
 
     if (widget->lookuptableVisible) {
         /// lookuptable
-        if (KIMToySettings::self()->verticalPreeditBar()) {
-            int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-            for (int i = 0; i < count; ++i) {
-                QString tmp = widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed();
-                w = qMax(QFontMetrics(m_candidateFont).width(tmp), w);
-                h += m_candidateFontHeight;
-            }
-        }
-        else {
-            QString tmp;
-            int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-            for (int i = 0; i < count; ++i) {
-                tmp += widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed() + ' ';
-            }
-            int lookuptablew = QFontMetrics(m_candidateFont).width(tmp);
-            w = qMax(lookuptablew, w);
-            h += m_candidateFontHeight;
-        }
+        QSize lookuptableSize = layout.lookupTableSize();
+        w = qMax(lookuptableSize.width(), w);
+        h += lookuptableSize.height();
     }
 
     if (!KIMToySettings::self()->enablePreeditResizing()) {
@@ -184,30 +168,30 @@ void ThemerPlasma::resizeStatusBar(const QSize& size)
 
 void ThemerPlasma::maskPreEditBar(PreEditBar* widget)
 {
-    widget->setMask(m_preeditBarSvg.mask());
+    applyMask(widget, m_preeditBarSvg.mask());
 }
 
 void ThemerPlasma::maskStatusBar(StatusBar* widget)
 {
-    widget->setMask(m_statusBarSvg.mask());
+    applyMask(widget, m_statusBarSvg.mask());
 }
 
 void ThemerPlasma::maskPropertyWidget(PropertyWidget* widget)
 {
     if (!widget->iconName().isEmpty())
-        widget->setMask(MainBarIcon(widget->iconName()).mask());
+        applyMask(widget, MainBarIcon(widget->iconName()).mask());
     else
-        widget->clearMask();
+        applyMask(widget, QRegion());
 }
 
 void ThemerPlasma::blurPreEditBar(PreEditBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, m_preeditBarSvg.mask());
+    applyBlurBehind(widget, m_preeditBarSvg.mask());
 }
 
 void ThemerPlasma::blurStatusBar(StatusBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, m_statusBarSvg.mask());
+    applyBlurBehind(widget, m_statusBarSvg.mask());
 }
 
 void ThemerPlasma::drawPreEditBar(PreEditBar* widget)
@@ -215,14 +199,12 @@ void ThemerPlasma::drawPreEditBar(PreEditBar* widget)
     QPainter p(widget);
 
     if (KIMToySettings::self()->backgroundColorizing()) {
-        p.save();
-        p.fillRect(widget->rect(), KIMToySettings::self()->preeditBarColorize());
-        p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-        p.drawPixmap(0, 0, m_preeditBarSvg.alphaMask());
-        p.restore();
+        drawColorizedLayer(&p, PreEditBarLayer, widget->size(),
+                           m_preeditBarSvg.framePixmap(), m_preeditBarSvg.alphaMask(),
+                           KIMToySettings::self()->preeditBarColorize());
     }
-
-    m_preeditBarSvg.paintFrame(&p);
+    else
+        m_preeditBarSvg.paintFrame(&p);
 
     qreal left, top, right, bottom;
     m_preeditBarSvg.getMargins(left, top, right, bottom);
@@ -236,7 +218,10 @@ void ThemerPlasma::drawPreEditBar(PreEditBar* widget)
         p.setFont(m_preEditFont);
         p.setPen(m_preEditColor);
 
-        p.drawText(x, y, widget->width(), m_preEditFontHeight, Qt::AlignLeft, widget->m_text + widget->m_auxText);
+        p.save();
+        p.setClipRect(x, y, widget->width(), m_preEditFontHeight, Qt::IntersectClip);
+        p.drawStaticText(x, y, preEditLayout(widget).preEditStaticText);
+        p.restore();
         if (widget->preeditVisible) {
             int pixelsWide = QFontMetrics(m_preEditFont).width(widget->m_text.left(widget->m_cursorPos));
             p.drawLine(pixelsWide, 0, pixelsWide, m_preEditFontHeight);
@@ -249,45 +234,7 @@ void ThemerPlasma::drawPreEditBar(PreEditBar* widget)
 
     if (widget->lookuptableVisible) {
         /// draw lookup table
-        int w = 0;
-        int h = qMax(m_labelFontHeight, m_candidateFontHeight);
-
-        /// draw labels and candidates
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-
-        if (KIMToySettings::self()->verticalPreeditBar()) {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                x = 0;
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed());
-                y += h;
-            }
-        }
-        else {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed() + ' ');
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed() + ' ');
-                x += w;
-            }
-        }
+        drawLookupTable(&p, widget, QPoint(x, y));
     }
 }
 
@@ -296,14 +243,12 @@ void ThemerPlasma::drawStatusBar(StatusBar* widget)
     QPainter p(widget);
 
     if (KIMToySettings::self()->backgroundColorizing()) {
-        p.save();
-        p.fillRect(widget->rect(), KIMToySettings::self()->statusBarColorize());
-        p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-        p.drawPixmap(0, 0, m_statusBarSvg.alphaMask());
-        p.restore();
+        drawColorizedLayer(&p, StatusBarLayer, widget->size(),
+                           m_statusBarSvg.framePixmap(), m_statusBarSvg.alphaMask(),
+                           KIMToySettings::self()->statusBarColorize());
     }
-
-    m_statusBarSvg.paintFrame(&p);
+    else
+        m_statusBarSvg.paintFrame(&p);
 }
 
 void ThemerPlasma::drawPropertyWidget(PropertyWidget* widget)
@@ -316,3 +261,22 @@ void ThemerPlasma::drawPropertyWidget(PropertyWidget* widget)
         p.drawText(widget->rect(), Qt::AlignCenter, widget->name());
     }
 }
+
+QRect ThemerPlasma::preEditCaretRect(const PreEditBar* widget) const
+{
+    qreal left, top, right, bottom;
+    m_preeditBarSvg.getMargins(left, top, right, bottom);
+    return caretRect(widget, QPointF(left, top).toPoint());
+}
+
+QRect ThemerPlasma::candidateRect(const PreEditBar* widget, int index) const
+{
+    qreal left, top, right, bottom;
+    m_preeditBarSvg.getMargins(left, top, right, bottom);
+    qreal y = top;
+    if (widget->preeditVisible || widget->auxVisible) {
+        /// preedit and spacing between preedit and lookuptable
+        y += m_preEditFontHeight + 4;
+    }
+    return candidateCellRect(widget, index, QPointF(left, y).toPoint());
+}
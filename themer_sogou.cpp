@@ -28,19 +28,19 @@
 #include <QImage>
 #include <QPainter>
 #include <QPixmap>
+#include <QScopedPointer>
 #include <QString>
 #include <QTextStream>
 
 #include <KIconLoader>
-#include <KWindowEffects>
 
 #include "animator.h"
-#include "kssf.h"
 
 #include "preeditbar.h"
 #include "statusbar.h"
 #include "statusbarlayout.h"
 #include "propertywidget.h"
+#include "skinsource.h"
 
 #include "kimtoysettings.h"
 
@@ -97,43 +97,7 @@ static void calculateOverlaySurrounding(const QHash<QString, OverlayPixmap*>& ov
     QHash<QString, OverlayPixmap*>::ConstIterator end = overlays.constEnd();
     while (it != end) {
         const OverlayPixmap* op = it.value();
-        const QPixmap& pixmap = op->currentPixmap();
-        switch (op->alignArea) {
-            case 1:
-                opl = qMax(opl, pixmap.width());
-                opt = qMax(opt, pixmap.height());
-                break;
-            case 2:
-                opt = qMax(opt, pixmap.height());
-                break;
-            case 3:
-                opr = qMax(opr, pixmap.width());
-                opt = qMax(opt, pixmap.height());
-                break;
-            case 4:
-                opl = qMax(opl, pixmap.width());
-                break;
-            case 5:
-                /// center pixmap, no addition
-                break;
-            case 6:
-                opr = qMax(opr, pixmap.width());
-                break;
-            case 7:
-                opl = qMax(opl, pixmap.width());
-                opb = qMax(opb, pixmap.height());
-                break;
-            case 8:
-                opb = qMax(opb, pixmap.height());
-                break;
-            case 9:
-                opr = qMax(opr, pixmap.width());
-                opb = qMax(opb, pixmap.height());
-                break;
-            default:
-                /// never arrive here
-                break;
-        }
+        OverlayLayout::expandSurrounding(*op, op->frameSize(), opt, opb, opl, opr);
         ++it;
     }
 }
@@ -151,6 +115,7 @@ ThemerSogou::ThemerSogou()
         : Themer()
 {
     m_statusBarSkin = 0;
+    m_placedVertical = false;
 }
 
 ThemerSogou::~ThemerSogou()
@@ -163,22 +128,17 @@ bool ThemerSogou::loadTheme()
     if (!QFile::exists(file))
         return false;
 
-    KSsf ssf(file);
-    if (!ssf.open(QIODevice::ReadOnly)) {
+    QScopedPointer<SkinSource> source(SkinSource::open(file));
+    if (!source)
         return false;
-    }
 
-    const KArchiveEntry* entry = ssf.directory()->entry("skin.ini");
-    const KArchiveFile* skinini = static_cast<const KArchiveFile*>(entry);
+    QString skinini = source->contains("skin.ini") ? "skin.ini" : "Skin.ini";
+    if (!source->contains(skinini))
+        return false;
 
-    if (!skinini) {
-        entry = ssf.directory()->entry("Skin.ini");
-        skinini = static_cast<const KArchiveFile*>(entry);
-        if (!skinini)
-            return false;
-    }
+    QByteArray data = source->data(skinini);
 
-    QByteArray data = skinini->data();
+    FrameStore::setBudget((qint64)KIMToySettings::self()->animationFrameCacheSize() * 1024 * 1024);
 
     /// parse ini file content
     bool general = false;
@@ -194,6 +154,8 @@ bool ThemerSogou::loadTheme()
     int h_hsl = 0, h_hsr = 0, h_vst = 0, h_vsb = 0, h_hstm = 0, h_vstm = 0;
     int v_hsl = 0, v_hsr = 0, v_vst = 0, v_vsb = 0, v_hstm = 0, v_vstm = 0;
 
+    m_placedOverlays.clear();
+    m_placedSize = QSize();
     qDeleteAll(h_overlays);
     qDeleteAll(v_overlays);
     h_overlays.clear();
@@ -254,10 +216,7 @@ bool ThemerSogou::loadTheme()
         }
         else if (scheme_h1) {
             if (key == "pic") {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix)
-                    h1skin.loadFromData(pix->data());
+                h1skin = source->pixmap(value);
             }
             else if (key == "layout_horizontal") {
                 QStringList list = value.split(',');
@@ -319,26 +278,16 @@ bool ThemerSogou::loadTheme()
                 op->alignTarget = numbers.at(9).toInt();
             }
             else if (h_overlays.contains(key)) {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix) {
-//                     h_overlays[ key ]->pixmap.loadFromData(pix->data());
+                if (source->contains(value)) {
                     OverlayPixmap* op = h_overlays[ key ];
-                    QBuffer* d = new QBuffer;
-                    d->setData(pix->data());
-                    op->setDevice(d);
-                    op->setFormat(value.endsWith(".gif") ? "gif" : "apng");
-                    d->setParent(op);
+                    source->loadFrames(op, value);
                     Animator::self()->connectPreEditBarMovie(op);
                 }
             }
         }
         else if (scheme_v1) {
             if (key == "pic") {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix)
-                    v1skin.loadFromData(pix->data());
+                v1skin = source->pixmap(value);
             }
             else if (key == "layout_horizontal") {
                 QStringList list = value.split(',');
@@ -396,50 +345,28 @@ bool ThemerSogou::loadTheme()
                 op->alignTarget = numbers.at(9).toInt();
             }
             else if (v_overlays.contains(key)) {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix) {
-//                     v_overlays[ key ]->pixmap.loadFromData(pix->data());
+                if (source->contains(value)) {
                     OverlayPixmap* op = v_overlays[ key ];
-                    QBuffer* d = new QBuffer;
-                    d->setData(pix->data());
-                    op->setDevice(d);
-                    op->setFormat(value.endsWith(".gif") ? "gif" : "apng");
-                    d->setParent(op);
+                    source->loadFrames(op, value);
                     Animator::self()->connectPreEditBarMovie(op);
                 }
             }
         }
         else if (statusbar) {
             if (key == "pic") {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix) {
-                    m_statusBarSkin = new QMovie;
-//                     m_statusBarSkin.loadFromData(pix->data());
-                    QBuffer* d = new QBuffer;
-                    d->setData(pix->data());
-                    m_statusBarSkin->setDevice(d);
-                    m_statusBarSkin->setFormat(value.endsWith(".gif") ? "gif" : "apng");
-                    d->setParent(m_statusBarSkin);
+                if (source->contains(value)) {
+                    m_statusBarSkin = new FrameStore;
+                    source->loadFrames(m_statusBarSkin, value);
                     Animator::self()->connectStatusBarMovie(m_statusBarSkin);
                 }
             }
 #define LOAD_PWPIX_VALUE(p1, p2) \
     do { \
         QStringList pics = value.split(','); \
-        const KArchiveEntry* e0 = ssf.directory()->entry(pics.at(0)); \
-        const KArchiveFile* pix0 = static_cast<const KArchiveFile*>(e0); \
-        if (pix0) { \
-            QPixmap& pix = m_pwpix[ p1 ]; \
-            pix.loadFromData(pix0->data()); \
-        } \
-        const KArchiveEntry* e1 = ssf.directory()->entry(pics.at(1)); \
-        const KArchiveFile* pix1 = static_cast<const KArchiveFile*>(e1); \
-        if (pix1) { \
-            QPixmap& pix = m_pwpix[ p2 ]; \
-            pix.loadFromData(pix1->data()); \
-        } \
+        if (source->contains(pics.at(0))) \
+            m_pwpix[ p1 ] = source->pixmap(pics.at(0)); \
+        if (source->contains(pics.at(1))) \
+            m_pwpix[ p2 ] = source->pixmap(pics.at(1)); \
     } while(0);
             else if (key == "cn_en") {
                 LOAD_PWPIX_VALUE(IM_Chinese, IM_Direct)
@@ -457,22 +384,15 @@ bool ThemerSogou::loadTheme()
                 LOAD_PWPIX_VALUE(Chinese_Traditional, Chinese_Simplified)
             }
             else if (key == "softkeyboard") {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix) {
-                    QPixmap& pwpix1 = m_pwpix[ SoftKeyboard_On ];
-                    pwpix1.loadFromData(pix->data());
-                    QPixmap& pwpix2 = m_pwpix[ SoftKeyboard_Off ];
-                    pwpix2.loadFromData(pix->data());
+                if (source->contains(value)) {
+                    QPixmap pwpix = source->pixmap(value);
+                    m_pwpix[ SoftKeyboard_On ] = pwpix;
+                    m_pwpix[ SoftKeyboard_Off ] = pwpix;
                 }
             }
             else if (key == "menu") {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix) {
-                    QPixmap& pwpix = m_pwpix[ Setup ];
-                    pwpix.loadFromData(pix->data());
-                }
+                if (source->contains(value))
+                    m_pwpix[ Setup ] = source->pixmap(value);
             }
 #undef LOAD_PWPIX_VALUE
 #define LOAD_PWPOS_VALUE(p1, p2) \
@@ -525,16 +445,9 @@ bool ThemerSogou::loadTheme()
                 op->ml = numbers.at(0).toInt();
             }
             else if (s_overlays.contains(key)) {
-                const KArchiveEntry* e = ssf.directory()->entry(value);
-                const KArchiveFile* pix = static_cast<const KArchiveFile*>(e);
-                if (pix) {
-//                     s_overlays[ key ]->pixmap.loadFromData(pix->data());
+                if (source->contains(value)) {
                     OverlayPixmap* op = s_overlays[ key ];
-                    QBuffer* d = new QBuffer;
-                    d->setData(pix->data());
-                    op->setDevice(d);
-                    op->setFormat(value.endsWith(".gif") ? "gif" : "apng");
-                    d->setParent(op);
+                    source->loadFrames(op, value);
                     Animator::self()->connectStatusBarMovie(op);
                 }
             }
@@ -566,6 +479,11 @@ bool ThemerSogou::loadTheme()
     calculateOverlaySurrounding(h_overlays, h_opt, h_opb, h_opl, h_opr);
     calculateOverlaySurrounding(v_overlays, v_opt, v_opb, v_opl, v_opr);
 
+    /// status bar overlays never move
+    foreach (const OverlayPixmap* op, s_overlays) {
+        Animator::self()->setMovieRect(op, QRect(QPoint(op->ml, op->mt), op->frameSize()));
+    }
+
     h_anchorY = calculateAnchor(h1skin, h_overlays, h_opt, h_opb, h_opl, h_opr);
     v_anchorY = calculateAnchor(v1skin, v_overlays, v_opt, v_opb, v_opl, v_opr);
     qWarning() << h_anchorY << v_anchorY;
@@ -593,50 +511,37 @@ QSize ThemerSogou::sizeHintPreEditBar(const PreEditBar* widget) const
 {
     const SkinPixmap& skin = KIMToySettings::self()->verticalPreeditBar()
                              ? v_preEditBarSkin : h_preEditBarSkin;
+    const PreEditLayout& layout = preEditLayout(widget);
     int w = skin.skinw();
     int h = skin.skinh();
 
+    int pt, pb, pl, pr;
+    int zt, zb, zl, zr;
+    int opt, opb, opl, opr;
     if (KIMToySettings::self()->verticalPreeditBar()) {
-        int widgetsh = v_pt + v_pb + v_zt + v_zb;
-
-        /// preedit and aux
-        int pinyinauxw = QFontMetrics(m_preEditFont).width(widget->m_text + widget->m_auxText);
-        w = qMax(pinyinauxw + v_pl + v_pr + v_opl + v_opr, w);
-        widgetsh += m_preEditFontHeight;
-
-        /// lookuptable
-        int lookuptablew = 0;
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-        for (int i = 0; i < count; ++i) {
-            QString tmp = widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed();
-            lookuptablew = qMax(QFontMetrics(m_candidateFont).width(tmp), lookuptablew);
-            widgetsh += m_candidateFontHeight;
-        }
-        w = qMax(lookuptablew + v_zl + v_zr + v_opl + v_opr, w);
-
-        h = qMax(widgetsh + v_opt + v_opb, h);
+        pt = v_pt, pb = v_pb, pl = v_pl, pr = v_pr;
+        zt = v_zt, zb = v_zb, zl = v_zl, zr = v_zr;
+        opt = v_opt, opb = v_opb, opl = v_opl, opr = v_opr;
     }
     else {
-        int widgetsh = h_pt + h_pb + h_zt + h_zb;
-
-        /// preedit and aux
-        int pinyinauxw = QFontMetrics(m_preEditFont).width(widget->m_text + widget->m_auxText);
-        w = qMax(pinyinauxw + h_pl + h_pr + h_opl + h_opr, w);
-        widgetsh += m_preEditFontHeight;
-
-        /// lookuptable
-        QString tmp;
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-        for (int i = 0; i < count; ++i) {
-            tmp += widget->m_labels.at(i).trimmed() + widget->m_candidates.at(i).trimmed() + ' ';
-        }
-        int lookuptablew = QFontMetrics(m_candidateFont).width(tmp);
-        w = qMax(lookuptablew + h_zl + h_zr + h_opl + h_opr, w);
-        widgetsh += m_candidateFontHeight;
-
-        h = qMax(widgetsh + h_opt + h_opb, h);
+        pt = h_pt, pb = h_pb, pl = h_pl, pr = h_pr;
+        zt = h_zt, zb = h_zb, zl = h_zl, zr = h_zr;
+        opt = h_opt, opb = h_opb, opl = h_opl, opr = h_opr;
     }
 
+    int widgetsh = pt + pb + zt + zb;
+
+    /// preedit and aux
+    w = qMax(layout.preEditWidth + pl + pr + opl + opr, w);
+    widgetsh += m_preEditFontHeight;
+
+    /// lookuptable
+    QSize lookuptableSize = layout.lookupTableSize();
+    w = qMax(lookuptableSize.width() + zl + zr + opl + opr, w);
+    widgetsh += lookuptableSize.height();
+
+    h = qMax(widgetsh + opt + opb, h);
+
     if (!KIMToySettings::self()->enablePreeditResizing()) {
         /// align with skin width + 70 * x
         const int align = 70;
@@ -652,7 +557,7 @@ QSize ThemerSogou::sizeHintStatusBar(const StatusBar* widget) const
 {
     Q_UNUSED(widget);
     if (m_statusBarSkin)
-        return m_statusBarSkin->currentPixmap().size();
+        return m_statusBarSkin->frameSize();
     return QSize(0, 0);
 }
 
@@ -698,6 +603,8 @@ void ThemerSogou::layoutStatusBar(StatusBarLayout* layout) const
 
 void ThemerSogou::resizePreEditBar(const QSize& size)
 {
+    placeOverlays(size);
+
     /// calculate mask if necessary
     if (KIMToySettings::self()->enableWindowMask()
             || KIMToySettings::self()->enableBackgroundBlur()
@@ -718,131 +625,59 @@ void ThemerSogou::resizeStatusBar(const QSize& size)
 
 void ThemerSogou::updatePreEditBarMask(const QSize& size)
 {
-    int opt, opb, opl, opr;
+    SpanMask mask;
 
     if (KIMToySettings::self()->verticalPreeditBar()) {
         v_preEditBarSkin.resizeRegion(size);
-        m_preEditBarMask = v_preEditBarSkin.currentRegion();
-        opt = v_opt, opb = v_opb, opl = v_opl, opr = v_opr;
+        mask = v_preEditBarSkin.currentMask();
     }
     else {
         h_preEditBarSkin.resizeRegion(size);
-        m_preEditBarMask = h_preEditBarSkin.currentRegion();
+        mask = h_preEditBarSkin.currentMask();
+    }
+
+    /// overlay pixmap regions, covering every animation frame
+    placeOverlays(size);
+    foreach (const PlacedOverlay& po, m_placedOverlays) {
+        mask.unite(po.overlay->unionMask(), po.rect.x(), po.rect.y());
+    }
+
+    m_preEditBarMask = mask.toRegion();
+}
+
+void ThemerSogou::placeOverlays(const QSize& size)
+{
+    const bool vertical = KIMToySettings::self()->verticalPreeditBar();
+    if (size == m_placedSize && vertical == m_placedVertical)
+        return;
+
+    m_placedSize = size;
+    m_placedVertical = vertical;
+    m_placedOverlays.clear();
+
+    int opt, opb, opl, opr;
+    if (vertical) {
+        opt = v_opt, opb = v_opb, opl = v_opl, opr = v_opr;
+    }
+    else {
         opt = h_opt, opb = h_opb, opl = h_opl, opr = h_opr;
     }
 
-    /// overlay pixmap regions
-    const QHash<QString, OverlayPixmap*>& overlays = KIMToySettings::self()->verticalPreeditBar()
-            ? v_overlays : h_overlays;
+    /// overlays of the other orientation are not shown
+    foreach (const OverlayPixmap* op, vertical ? h_overlays : v_overlays) {
+        Animator::self()->setMovieRect(op, QRect());
+    }
+
+    const QHash<QString, OverlayPixmap*>& overlays = vertical ? v_overlays : h_overlays;
+    m_placedOverlays.reserve(overlays.count());
     QHash<QString, OverlayPixmap*>::ConstIterator it = overlays.constBegin();
     QHash<QString, OverlayPixmap*>::ConstIterator end = overlays.constEnd();
     while (it != end) {
-        const OverlayPixmap* op = it.value();
-        const QPixmap& pixmap = op->currentPixmap();
-        QRegion opRegion = pixmap.mask();
-        switch (op->alignArea) {
-            case 1:
-                opRegion.translate(op->ml, op->mt);
-                break;
-            case 2:
-                if (op->alignHMode == 0) {
-                    opRegion.translate((size.width() + opl - opr - pixmap.width()) / 2, 0);
-                    opRegion.translate(op->ml / 2, op->mt);
-                }
-                else if (op->alignHMode == 1) {
-                    opRegion.translate(opl, 0);
-                    opRegion.translate(op->ml, op->mt);
-                }
-                else if (op->alignHMode == 2) {
-                    opRegion.translate(size.width() - opr - pixmap.width(), 0);
-                    opRegion.translate(-op->mr, op->mt);
-                }
-                break;
-            case 3:
-                opRegion.translate(size.width() - opr, 0);
-                opRegion.translate(-op->mr, op->mt);
-                break;
-            case 4:
-                if (op->alignVMode == 0) {
-                    opRegion.translate(0, (size.height() - opb + opt - pixmap.height()) / 2);
-                    opRegion.translate(op->ml, op->mt / 2);
-                }
-                else if (op->alignVMode == 1) {
-                    opRegion.translate(0, opt);
-                    opRegion.translate(op->ml, op->mt);
-                }
-                else if (op->alignVMode == 2) {
-                    opRegion.translate(0, size.height() - opb - pixmap.height());
-                    opRegion.translate(op->ml, -op->mb);
-                }
-                break;
-            case 5:
-                if (op->alignHMode == 0) {
-                    opRegion.translate((size.width() + opl - opr - pixmap.width()) / 2, 0);
-                    opRegion.translate(op->ml / 2, 0);
-                }
-                else if (op->alignHMode == 1) {
-                    opRegion.translate(opl, 0);
-                    opRegion.translate(op->ml, 0);
-                }
-                else if (op->alignHMode == 2) {
-                    opRegion.translate(size.width() - opr - pixmap.width(), 0);
-                    opRegion.translate(-op->mr, 0);
-                }
-                if (op->alignVMode == 0) {
-                    opRegion.translate(0, (size.height() - opb + opt - pixmap.height()) / 2);
-                    opRegion.translate(0, op->mt / 2);
-                }
-                else if (op->alignVMode == 1) {
-                    opRegion.translate(0, opt);
-                    opRegion.translate(0, op->mt);
-                }
-                else if (op->alignVMode == 2) {
-                    opRegion.translate(0, size.height() - opb - pixmap.height());
-                    opRegion.translate(0, -op->mb);
-                }
-                break;
-            case 6:
-                if (op->alignVMode == 0) {
-                    opRegion.translate(size.width() - opr, (size.height() - opb + opt - pixmap.height()) / 2);
-                    opRegion.translate(-op->mr, op->mt / 2);
-                }
-                else if (op->alignVMode == 1) {
-                    opRegion.translate(size.width() - opr, opt);
-                    opRegion.translate(-op->mr, op->mt);
-                }
-                else if (op->alignVMode == 2) {
-                    opRegion.translate(size.width() - opr, size.height() - opb - pixmap.height());
-                    opRegion.translate(-op->mr, -op->mb);
-                }
-                break;
-            case 7:
-                opRegion.translate(0, size.height() - opb);
-                opRegion.translate(op->ml, -op->mb);
-                break;
-            case 8:
-                if (op->alignHMode == 0) {
-                    opRegion.translate((size.width() + opl - opr - pixmap.width()) / 2, size.height() - opb);
-                    opRegion.translate(op->ml / 2, -op->mb);
-                }
-                else if (op->alignHMode == 1) {
-                    opRegion.translate(opl, size.height() - opb);
-                    opRegion.translate(op->ml, -op->mb);
-                }
-                else if (op->alignHMode == 2) {
-                    opRegion.translate(size.width() - opr - pixmap.width(), size.height() - opb);
-                    opRegion.translate(-op->mr, -op->mb);
-                }
-                break;
-            case 9:
-                opRegion.translate(size.width() - opr, size.height() - opb);
-                opRegion.translate(-op->mr, -op->mb);
-                break;
-            default:
-                /// never arrive here
-                break;
-        }
-        m_preEditBarMask |= opRegion;
+        PlacedOverlay po;
+        po.overlay = it.value();
+        po.rect = OverlayLayout::place(*po.overlay, po.overlay->frameSize(), size, opt, opb, opl, opr);
+        m_placedOverlays.append(po);
+        Animator::self()->setMovieRect(po.overlay, po.rect);
         ++it;
     }
 }
@@ -851,12 +686,12 @@ void ThemerSogou::updateStatusBarMask(const QSize& size)
 {
 //     m_statusBarSkin = m_statusBarSkin.scaled(size);
 if (m_statusBarSkin)
-    m_statusBarMask = m_statusBarSkin->currentPixmap().mask();
+    m_statusBarMask = m_statusBarSkin->unionMask().toRegion();
 }
 
 void ThemerSogou::maskPreEditBar(PreEditBar* widget)
 {
-    widget->setMask(m_preEditBarMask);
+    applyMask(widget, m_preEditBarMask);
 }
 
 void ThemerSogou::maskStatusBar(StatusBar* widget)
@@ -865,27 +700,27 @@ void ThemerSogou::maskStatusBar(StatusBar* widget)
     foreach(const QLayoutItem* item, widget->m_layout->m_items) {
         mask |= item->geometry();
     }
-    widget->setMask(mask);
+    applyMask(widget, mask);
 }
 
 void ThemerSogou::maskPropertyWidget(PropertyWidget* widget)
 {
     if (m_pwpix.contains(widget->type()))
-        widget->setMask(m_pwpix.value(widget->type()).mask());
+        applyMask(widget, m_pwpix.value(widget->type()).mask());
     else if (!widget->iconName().isEmpty())
-        widget->setMask(MainBarIcon(widget->iconName()).mask());
+        applyMask(widget, MainBarIcon(widget->iconName()).mask());
     else
-        widget->clearMask();
+        applyMask(widget, QRegion());
 }
 
 void ThemerSogou::blurPreEditBar(PreEditBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, m_preEditBarMask);
+    applyBlurBehind(widget, m_preEditBarMask);
 }
 
 void ThemerSogou::blurStatusBar(StatusBar* widget)
 {
-    KWindowEffects::enableBlurBehind(widget->winId(), true, m_statusBarMask);
+    applyBlurBehind(widget, m_statusBarMask);
 }
 
 void ThemerSogou::drawPreEditBar(PreEditBar* widget)
@@ -901,17 +736,9 @@ void ThemerSogou::drawPreEditBar(PreEditBar* widget)
     QPainter p(widget);
 
     if (KIMToySettings::self()->backgroundColorizing()) {
-        QImage renderedSkin(widget->size(), QImage::Format_ARGB32_Premultiplied);
-        renderedSkin.fill(Qt::transparent);
-        QPainter p2(&renderedSkin);
-        preEditBarSkin.drawPixmap(&p2, widget->width(), widget->height());
-
-        p.save();
-        p.fillRect(widget->rect(), KIMToySettings::self()->preeditBarColorize());
-        p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-        p.drawImage(0, 0, renderedSkin);
-        p.restore();
-        p.drawImage(0, 0, renderedSkin);
+        const QPixmap skin = preEditBarSkin.pixmap(widget->size());
+        drawColorizedLayer(&p, PreEditBarLayer, widget->size(), skin, skin,
+                           KIMToySettings::self()->preeditBarColorize());
     }
     else
         preEditBarSkin.drawPixmap(&p, widget->width(), widget->height());
@@ -932,120 +759,9 @@ void ThemerSogou::drawPreEditBar(PreEditBar* widget)
     }
 
     /// draw overlay pixmap
-    const QHash<QString, OverlayPixmap*>& overlays = KIMToySettings::self()->verticalPreeditBar()
-            ? v_overlays : h_overlays;
-    QHash<QString, OverlayPixmap*>::ConstIterator it = overlays.constBegin();
-    QHash<QString, OverlayPixmap*>::ConstIterator end = overlays.constEnd();
-    while (it != end) {
-        const OverlayPixmap* op = it.value();
-        const QPixmap& pixmap = op->currentPixmap();
-        p.save();
-        switch (op->alignArea) {
-            case 1:
-                p.translate(op->ml, op->mt);
-                break;
-            case 2:
-                if (op->alignHMode == 0) {
-                    p.translate((widget->width() + opl - opr - pixmap.width()) / 2, 0);
-                    p.translate(op->ml / 2, op->mt);
-                }
-                else if (op->alignHMode == 1) {
-                    p.translate(opl, 0);
-                    p.translate(op->ml, op->mt);
-                }
-                else if (op->alignHMode == 2) {
-                    p.translate(widget->width() - opr - pixmap.width(), 0);
-                    p.translate(-op->mr, op->mt);
-                }
-                break;
-            case 3:
-                p.translate(widget->width() - opr, 0);
-                p.translate(-op->mr, op->mt);
-                break;
-            case 4:
-                if (op->alignVMode == 0) {
-                    p.translate(0, (widget->height() - opb + opt - pixmap.height()) / 2);
-                    p.translate(op->ml, op->mt / 2);
-                }
-                else if (op->alignVMode == 1) {
-                    p.translate(0, opt);
-                    p.translate(op->ml, op->mt);
-                }
-                else if (op->alignVMode == 2) {
-                    p.translate(0, widget->height() - opb - pixmap.height());
-                    p.translate(op->ml, -op->mb);
-                }
-                break;
-            case 5:
-                if (op->alignHMode == 0) {
-                    p.translate((widget->width() + opl - opr - pixmap.width()) / 2, 0);
-                    p.translate(op->ml / 2, 0);
-                }
-                else if (op->alignHMode == 1) {
-                    p.translate(opl, 0);
-                    p.translate(op->ml, 0);
-                }
-                else if (op->alignHMode == 2) {
-                    p.translate(widget->width() - opr - pixmap.width(), 0);
-                    p.translate(-op->mr, 0);
-                }
-                if (op->alignVMode == 0) {
-                    p.translate(0, (widget->height() - opb + opt - pixmap.height()) / 2);
-                    p.translate(0, op->mt / 2);
-                }
-                else if (op->alignVMode == 1) {
-                    p.translate(0, opt);
-                    p.translate(0, op->mt);
-                }
-                else if (op->alignVMode == 2) {
-                    p.translate(0, widget->height() - opb - pixmap.height());
-                    p.translate(0, -op->mb);
-                }
-                break;
-            case 6:
-                if (op->alignVMode == 0) {
-                    p.translate(widget->width() - opr, (widget->height() - opb + opt - pixmap.height()) / 2);
-                    p.translate(-op->mr, op->mt / 2);
-                }
-                else if (op->alignVMode == 1) {
-                    p.translate(widget->width() - opr, opt);
-                    p.translate(-op->mr, op->mt);
-                }
-                else if (op->alignVMode == 2) {
-                    p.translate(widget->width() - opr, widget->height() - opb - pixmap.height());
-                    p.translate(-op->mr, -op->mb);
-                }
-                break;
-            case 7:
-                p.translate(0, widget->height() - opb);
-                p.translate(op->ml, -op->mb);
-                break;
-            case 8:
-                if (op->alignHMode == 0) {
-                    p.translate((widget->width() + opl - opr - pixmap.width()) / 2, widget->height() - opb);
-                    p.translate(op->ml / 2, -op->mb);
-                }
-                else if (op->alignHMode == 1) {
-                    p.translate(opl, widget->height() - opb);
-                    p.translate(op->ml, -op->mb);
-                }
-                else if (op->alignHMode == 2) {
-                    p.translate(widget->width() - opr - pixmap.width(), widget->height() - opb);
-                    p.translate(-op->mr, -op->mb);
-                }
-                break;
-            case 9:
-                p.translate(widget->width() - opr, widget->height() - opb);
-                p.translate(-op->mr, -op->mb);
-                break;
-            default:
-                /// never arrive here
-                break;
-        }
-//         p.drawPixmap(0, 0, op->pixmap);
-        p.drawPixmap(0, 0, pixmap);
-        p.restore();
-        ++it;
+    placeOverlays(widget->size());
+    foreach (const PlacedOverlay& po, m_placedOverlays) {
+        p.drawPixmap(po.rect.topLeft(), po.overlay->currentPixmap());
     }
 
     if (separatorColor != Qt::transparent) {
@@ -1054,6 +770,11 @@ void ThemerSogou::drawPreEditBar(PreEditBar* widget)
         p.drawLine(opl + sepl, sepy, widget->width() - opr - sepr, sepy);
     }
 
+    /// animation ticks outside the text area leave the text untouched
+    const QRect textRect(opl, opt, widget->width() - opl - opr, widget->height() - opt - opb);
+    if (!widget->m_paintRect.intersects(textRect))
+        return;
+
     p.translate(opl, opt);
     int y = 0;
 
@@ -1064,7 +785,11 @@ void ThemerSogou::drawPreEditBar(PreEditBar* widget)
         p.setFont(m_preEditFont);
         p.setPen(m_preEditColor);
 
-        p.drawText(pl, pt, widget->width() - pl - pr, m_preEditFontHeight, Qt::AlignLeft, widget->m_text + widget->m_auxText);
+        /// static text ignores the text area, clip it like drawText did
+        p.save();
+        p.setClipRect(pl, pt, widget->width() - pl - pr, m_preEditFontHeight, Qt::IntersectClip);
+        p.drawStaticText(pl, pt, preEditLayout(widget).preEditStaticText);
+        p.restore();
         if (widget->preeditVisible) {
             int pixelsWide = QFontMetrics(m_preEditFont).width(widget->m_text.left(widget->m_cursorPos));
             p.drawLine(pl + pixelsWide, pt, pl + pixelsWide, pt + m_preEditFontHeight);
@@ -1077,46 +802,8 @@ void ThemerSogou::drawPreEditBar(PreEditBar* widget)
 
     if (widget->lookuptableVisible) {
         /// draw lookup table
-        int x = zl;
         y += zt;
-        int w = 0;
-        int h = qMax(m_labelFontHeight, m_candidateFontHeight);
-
-        /// draw labels and candidates
-        int count = qMin(widget->m_labels.count(), widget->m_candidates.count());
-
-        if (KIMToySettings::self()->verticalPreeditBar()) {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                x = zl;
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed());
-                y += h;
-            }
-        }
-        else {
-            for (int i = 0; i < count; ++i) {
-                /// draw label
-                p.setFont(m_labelFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_labelColor);
-                w = p.fontMetrics().width(widget->m_labels.at(i).trimmed());
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_labels.at(i).trimmed());
-                x += w;
-                /// draw candidate
-                p.setFont(m_candidateFont);
-                p.setPen(i == widget->m_candidateCursor ? m_candidateCursorColor : m_candidateColor);
-                w = p.fontMetrics().width(widget->m_candidates.at(i).trimmed() + ' ');
-                p.drawText(x, y, w, h, Qt::AlignCenter, widget->m_candidates.at(i).trimmed() + ' ');
-                x += w;
-            }
-        }
+        drawLookupTable(&p, widget, QPoint(zl, y));
     }
 }
 
@@ -1125,18 +812,9 @@ void ThemerSogou::drawStatusBar(StatusBar* widget)
     QPainter p(widget);
 
     if (KIMToySettings::self()->backgroundColorizing()) {
-        QImage renderedSkin(widget->size(), QImage::Format_ARGB32_Premultiplied);
-        renderedSkin.fill(Qt::transparent);
-        QPainter p2(&renderedSkin);
-        if (m_statusBarSkin)
-        p2.drawPixmap(0, 0, m_statusBarSkin->currentPixmap());
-
-        p.save();
-        p.fillRect(widget->rect(), KIMToySettings::self()->statusBarColorize());
-        p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-        p.drawImage(0, 0, renderedSkin);
-        p.restore();
-        p.drawImage(0, 0, renderedSkin);
+        const QPixmap skin = m_statusBarSkin ? m_statusBarSkin->currentPixmap() : QPixmap();
+        drawColorizedLayer(&p, StatusBarLayer, widget->size(), skin, skin,
+                           KIMToySettings::self()->statusBarColorize());
     }
     else
         if (m_statusBarSkin)
@@ -1162,3 +840,19 @@ void ThemerSogou::drawPropertyWidget(PropertyWidget* widget)
     else
         p.drawText(widget->rect(), Qt::AlignCenter, widget->name());
 }
+
+QRect ThemerSogou::preEditCaretRect(const PreEditBar* widget) const
+{
+    if (KIMToySettings::self()->verticalPreeditBar())
+        return caretRect(widget, QPoint(v_opl + v_pl, v_opt + v_pt));
+    else
+        return caretRect(widget, QPoint(h_opl + h_pl, h_opt + h_pt));
+}
+
+QRect ThemerSogou::candidateRect(const PreEditBar* widget, int index) const
+{
+    if (KIMToySettings::self()->verticalPreeditBar())
+        return candidateCellRect(widget, index, QPoint(v_opl + v_zl, v_opt + v_pt + m_preEditFontHeight + v_pb + v_zt));
+    else
+        return candidateCellRect(widget, index, QPoint(h_opl + h_zl, h_opt + h_pt + m_preEditFontHeight + h_pb + h_zt));
+}
@@ -22,36 +22,17 @@
 #ifndef THEMER_SOGOU_H
 #define THEMER_SOGOU_H
 
+#include "framestore.h"
+#include "overlaylayout.h"
 #include "propertywidget.h"
 #include "skinpixmap.h"
 #include "themer.h"
 
 #include <QHash>
+#include <QVector>
 
-#include <QMovie>
-#include <QBuffer>
-
-class OverlayPixmap : public QMovie
+class OverlayPixmap : public FrameStore, public OverlayAlign
 {
-public:
-    /**
-     * overlay layout
-     *
-     *  lt|                t              |rt
-     * ---+===============================+---
-     *    |      ##### preedit #####      |
-     *   l|-------------center------------|r
-     *    |      #### candidate ####      |
-     * ---+===============================+---
-     *  lb|                b              |rb
-     *
-     */
-    /// TODO: only entire window is supported atm --- nihui
-    int alignTarget;// 0->entire window, 1->preedit window, 2->candidate window
-    int alignArea;// 1->lt, 2->t, 3->rt, 4->l, 5->center, 6->r, 7->lb, 8->b, 9->rb
-    int alignHMode;// 0->align center, 1->align left, 2->align right
-    int alignVMode;// 0->align center, 1->align top, 2->align bottom
-    int mt, mb, ml, mr;// margins
 };
 
 class ThemerSogou : public Themer
@@ -74,9 +55,12 @@ public:
     virtual void drawPreEditBar(PreEditBar* widget);
     virtual void drawStatusBar(StatusBar* widget);
     virtual void drawPropertyWidget(PropertyWidget* widget);
+    virtual QRect preEditCaretRect(const PreEditBar* widget) const;
+    virtual QRect candidateRect(const PreEditBar* widget, int index) const;
 private:
     void updatePreEditBarMask(const QSize& size);
     void updateStatusBarMask(const QSize& size);
+    void placeOverlays(const QSize& size);
 
     /**
      * preedit bar layout
@@ -107,6 +91,15 @@ private:
     int h_opt, h_opb, h_opl, h_opr;
     int v_opt, v_opb, v_opl, v_opr;
 
+    /// overlay rectangles resolved for m_placedSize and orientation
+    struct PlacedOverlay {
+        const OverlayPixmap* overlay;
+        QRect rect;
+    };
+    QVector<PlacedOverlay> m_placedOverlays;
+    QSize m_placedSize;
+    bool m_placedVertical;
+
     /// optional
     QColor h_separatorColor;
     QColor v_separatorColor;
@@ -126,7 +119,7 @@ private:
      * |<------skin width------>|
      */
 //     QPixmap m_statusBarSkin;
-    QMovie* m_statusBarSkin;
+    FrameStore* m_statusBarSkin;
     QHash<QString, OverlayPixmap*> s_overlays;
 
     QHash<PropertyType, QPoint> m_pwpos;
@@ -23,6 +23,7 @@
 
 #include <QSize>
 
+#include "compiledskin.h"
 #include "themer_fcitx.h"
 #include "themer_none.h"
 #include "themer_plasma.h"
@@ -47,6 +48,16 @@ void ThemerAgent::loadSettings()
     else if (themeUri.endsWith(".ssf")) {
         m_themer = ThemerSogou::self();
     }
+    else if (themeUri.endsWith(COMPILEDSKIN_SUFFIX)) {
+        /// compiled skins keep the layout rules of the skin they came from
+        CompiledSkin::SourceType type = CompiledSkin::sourceType(themeUri);
+        if (type == CompiledSkin::SogouSource)
+            m_themer = ThemerSogou::self();
+        else if (type == CompiledSkin::FcitxSource)
+            m_themer = ThemerFcitx::self();
+        else
+            m_themer = ThemerNone::self();
+    }
     else {
         m_themer = ThemerNone::self();
     }
@@ -54,6 +65,8 @@ void ThemerAgent::loadSettings()
 
 void ThemerAgent::loadTheme()
 {
+    Themer::clearColorizedLayers();
+
     bool success = m_themer->loadTheme();
     if (!success) {
         m_themer = ThemerNone::self();
@@ -144,3 +157,13 @@ void ThemerAgent::drawPropertyWidget(PropertyWidget* widget)
         return ThemerNone::self()->drawPropertyWidget(widget);
     m_themer->drawPropertyWidget(widget);
 }
+
+QRect ThemerAgent::preEditCaretRect(const PreEditBar* widget)
+{
+    return m_themer->preEditCaretRect(widget);
+}
+
+QRect ThemerAgent::candidateRect(const PreEditBar* widget, int index)
+{
+    return m_themer->candidateRect(widget, index);
+}
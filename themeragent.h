@@ -23,6 +23,7 @@
 #define THEMERAGENT_H
 
 #include <QPoint>
+#include <QRect>
 #include <QSize>
 
 class PreEditBar;
@@ -49,6 +50,8 @@ void blurStatusBar(StatusBar* widget);
 void drawPreEditBar(PreEditBar* widget);
 void drawStatusBar(StatusBar* widget);
 void drawPropertyWidget(PropertyWidget* widget);
+QRect preEditCaretRect(const PreEditBar* widget);
+QRect candidateRect(const PreEditBar* widget, int index);
 }
 
 #endif // THEMERAGENT_H
@@ -26,10 +26,13 @@
 #include <QPixmap>
 #include <QColor>
 #include <QFile>
+#include <QScopedPointer>
 #include <QString>
 #include <QTextStream>
 #include <KTar>
 
+#include "../themecache.h"
+
 extern "C"
 {
     Q_DECL_EXPORT ThumbCreator* new_creator() {
@@ -64,7 +67,11 @@ bool FskinCreator::create(const QString& path, int width, int height, QImage& im
     if (!QFile::exists(path))
         return false;
 
-    KTar tar(path);
+    QScopedPointer<QIODevice> dev(ThemeCache::openTar(path));
+    if (!dev)
+        return false;
+
+    KTar tar(dev.data());
     if (!tar.open(QIODevice::ReadOnly))
         return false;
 
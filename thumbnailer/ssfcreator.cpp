@@ -30,6 +30,7 @@
 #include <QTextStream>
 
 #include "../kssf.h"
+#include "../overlaylayout.h"
 
 extern "C"
 {
@@ -38,16 +39,10 @@ extern "C"
     }
 }
 
-class OverlayPixmap
+class OverlayPixmap : public OverlayAlign
 {
 public:
     QPixmap pixmap;
-    /// TODO: only entire window is supported atm --- nihui
-    int alignTarget;// 0->entire window, 1->preedit window, 2->candidate window
-    int alignArea;// 1->lt, 2->t, 3->rt, 4->l, 5->center, 6->r, 7->lb, 8->b, 9->rb
-    int alignHMode;// 0->align center, 1->align left, 2->align right
-    int alignVMode;// 0->align center, 1->align top, 2->align bottom
-    int mt, mb, ml, mr;// margins
 };
 
 SsfCreator::SsfCreator()
@@ -203,42 +198,7 @@ bool SsfCreator::create(const QString& path, int width, int height, QImage& img)
     QHash<QString, OverlayPixmap>::ConstIterator end = overlays.constEnd();
     while (it != end) {
         const OverlayPixmap& op = it.value();
-        switch (op.alignArea) {
-            case 1:
-                opl = qMax(opl, op.pixmap.width());
-                opt = qMax(opt, op.pixmap.height());
-                break;
-            case 2:
-                opt = qMax(opt, op.pixmap.height());
-                break;
-            case 3:
-                opr = qMax(opr, op.pixmap.width());
-                opt = qMax(opt, op.pixmap.height());
-                break;
-            case 4:
-                opl = qMax(opl, op.pixmap.width());
-                break;
-            case 5:
-                /// center pixmap, no addition
-                break;
-            case 6:
-                opr = qMax(opr, op.pixmap.width());
-                break;
-            case 7:
-                opl = qMax(opl, op.pixmap.width());
-                opb = qMax(opb, op.pixmap.height());
-                break;
-            case 8:
-                opb = qMax(opb, op.pixmap.height());
-                break;
-            case 9:
-                opr = qMax(opr, op.pixmap.width());
-                opb = qMax(opb, op.pixmap.height());
-                break;
-            default:
-                /// never arrive here
-                break;
-        }
+        OverlayLayout::expandSurrounding(op, op.pixmap.size(), opt, opb, opl, opr);
         ++it;
     }
 
@@ -287,111 +247,8 @@ bool SsfCreator::create(const QString& path, int width, int height, QImage& img)
     end = overlays.constEnd();
     while (it != end) {
         const OverlayPixmap& op = it.value();
-        p.save();
-        switch (op.alignArea) {
-            case 1:
-                p.translate(op.ml, op.mt);
-                break;
-            case 2:
-                if (op.alignHMode == 0) {
-                    p.translate((width + opl - opr - op.pixmap.width()) / 2, 0);
-                    p.translate(op.ml / 2, op.mt);
-                }
-                else if (op.alignHMode == 1) {
-                    p.translate(opl, 0);
-                    p.translate(op.ml, op.mt);
-                }
-                else if (op.alignHMode == 2) {
-                    p.translate(width - opr - op.pixmap.width(), 0);
-                    p.translate(-op.mr, op.mt);
-                }
-                break;
-            case 3:
-                p.translate(width - opr, 0);
-                p.translate(-op.mr, op.mt);
-                break;
-            case 4:
-                if (op.alignVMode == 0) {
-                    p.translate(0, (height - opb + opt - op.pixmap.height()) / 2);
-                    p.translate(op.ml, op.mt / 2);
-                }
-                else if (op.alignVMode == 1) {
-                    p.translate(0, opt);
-                    p.translate(op.ml, op.mt);
-                }
-                else if (op.alignVMode == 2) {
-                    p.translate(0, height - opb - op.pixmap.height());
-                    p.translate(op.ml, -op.mb);
-                }
-                break;
-            case 5:
-                if (op.alignHMode == 0) {
-                    p.translate((width + opl - opr - op.pixmap.width()) / 2, 0);
-                    p.translate(op.ml / 2, 0);
-                }
-                else if (op.alignHMode == 1) {
-                    p.translate(opl, 0);
-                    p.translate(op.ml, 0);
-                }
-                else if (op.alignHMode == 2) {
-                    p.translate(width - opr - op.pixmap.width(), 0);
-                    p.translate(-op.mr, 0);
-                }
-                if (op.alignVMode == 0) {
-                    p.translate(0, (height - opb + opt - op.pixmap.height()) / 2);
-                    p.translate(0, op.mt / 2);
-                }
-                else if (op.alignVMode == 1) {
-                    p.translate(0, opt);
-                    p.translate(0, op.mt);
-                }
-                else if (op.alignVMode == 2) {
-                    p.translate(0, height - opb - op.pixmap.height());
-                    p.translate(0, -op.mb);
-                }
-                break;
-            case 6:
-                if (op.alignVMode == 0) {
-                    p.translate(width - opr, (height - opb + opt - op.pixmap.height()) / 2);
-                    p.translate(-op.mr, op.mt / 2);
-                }
-                else if (op.alignVMode == 1) {
-                    p.translate(width - opr, opt);
-                    p.translate(-op.mr, op.mt);
-                }
-                else if (op.alignVMode == 2) {
-                    p.translate(width - opr, height - opb - op.pixmap.height());
-                    p.translate(-op.mr, -op.mb);
-                }
-                break;
-            case 7:
-                p.translate(0, height - opb);
-                p.translate(op.ml, -op.mb);
-                break;
-            case 8:
-                if (op.alignHMode == 0) {
-                    p.translate((width + opl - opr - op.pixmap.width()) / 2, height - opb);
-                    p.translate(op.ml / 2, -op.mb);
-                }
-                else if (op.alignHMode == 1) {
-                    p.translate(opl, height - opb);
-                    p.translate(op.ml, -op.mb);
-                }
-                else if (op.alignHMode == 2) {
-                    p.translate(width - opr - op.pixmap.width(), height - opb);
-                    p.translate(-op.mr, -op.mb);
-                }
-                break;
-            case 9:
-                p.translate(width - opr, height - opb);
-                p.translate(-op.mr, -op.mb);
-                break;
-            default:
-                /// never arrive here
-                break;
-        }
-        p.drawPixmap(0, 0, op.pixmap);
-        p.restore();
+        QRect rect = OverlayLayout::place(op, op.pixmap.size(), QSize(width, height), opt, opb, opl, opr);
+        p.drawPixmap(rect.topLeft(), op.pixmap);
         ++it;
     }
 